@@ -1,18 +1,51 @@
 #include <bits/stdc++.h>
 using namespace std;
 
+/*
+ * Tic-Tac-Toe with Minimax (alpha-beta) on an N x N board, K in a row wins.
+ * Usage:
+ *   Assignment5                                  # classic 3x3 game
+ *   Assignment5 play [size] [win] [threads] [depth]
+ *   Assignment5 smp  [size] [win] [maxThreads] [depth]
+ *   Assignment5 mcts [size] [win] [threads] [playouts] [ms] [nodes]
+ *   Assignment5 perft [size] [win] [depth]
+ *   Assignment5 selfplay [size] [win] [games] [xEngine] [oEngine] [seed] [randomPlies]
+ *   Assignment5 verify
+ *          smp: search the empty board with 1..maxThreads threads and
+ *               report nodes/sec and speedup for each thread count.
+ *          mcts: play against UCT search; playouts and ms are per-move
+ *                budgets (0 = unlimited), nodes is the arena size per thread.
+ *          perft: JSON node counts per depth, checked against a second
+ *                 move generator (and reference counts on 3x3).
+ *          selfplay: engine-vs-engine games, one JSON summary with outcomes,
+ *                 nodes/sec, average and p99 move latency. Engines: table,
+ *                 minimax, smp[:depth], mcts[:playouts], random.
+ *          verify: check the compile-time 3x3 table against minimax.
+ *          depth 0 = search to the end of the game.
+ */
+
 const char HUMAN = 'O';
 const char AI = 'X';
 const char EMPTY = '_';
 
+// Board geometry (classic 3x3 unless set from the command line)
+int BOARD_N = 3;    // board is BOARD_N x BOARD_N
+int WIN_LEN = 3;    // marks in a row needed to win
+int WIN_SCORE = 10; // score of a won position before depth adjustment
+
+// Search settings for the AI player
+int SEARCH_THREADS = 1;
+int SEARCH_DEPTH = 0; // 0 = no depth limit
+
 struct Move {
     int row, col;
 };
 
 // Check if moves are left
 bool isMovesLeft(vector<vector<char>> &board) {
-    for (int i = 0; i < 3; i++)
-        for (int j = 0; j < 3; j++)
+    int n = board.size();
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
             if (board[i][j] == EMPTY)
                 return true;
     return false;
@@ -20,44 +53,42 @@ bool isMovesLeft(vector<vector<char>> &board) {
 
 // Evaluate board state
 int evaluate(vector<vector<char>> &b) {
-    // Check rows
-    for (int row = 0; row < 3; row++) {
-        if (b[row][0] == b[row][1] && b[row][1] == b[row][2]) {
-            if (b[row][0] == AI) return +10;
-            else if (b[row][0] == HUMAN) return -10;
-        }
-    }
-    // Check columns
-    for (int col = 0; col < 3; col++) {
-        if (b[0][col] == b[1][col] && b[1][col] == b[2][col]) {
-            if (b[0][col] == AI) return +10;
-            else if (b[0][col] == HUMAN) return -10;
+    // Rows, then columns, then diagonals, then anti-diagonals
+    static const int dr[4] = {0, 1, 1, 1};
+    static const int dc[4] = {1, 0, 1, -1};
+    int n = b.size();
+    for (int d = 0; d < 4; d++) {
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < n; c++) {
+                char p = b[r][c];
+                if (p == EMPTY) continue;
+                int er = r + dr[d] * (WIN_LEN - 1), ec = c + dc[d] * (WIN_LEN - 1);
+                if (er < 0 || er >= n || ec < 0 || ec >= n) continue;
+                int k = 1;
+                while (k < WIN_LEN && b[r + dr[d] * k][c + dc[d] * k] == p) k++;
+                if (k == WIN_LEN) return p == AI ? +WIN_SCORE : -WIN_SCORE;
+            }
         }
     }
-    // Check diagonals
-    if (b[0][0] == b[1][1] && b[1][1] == b[2][2]) {
-        if (b[0][0] == AI) return +10;
-        else if (b[0][0] == HUMAN) return -10;
-    }
-    if (b[0][2] == b[1][1] && b[1][1] == b[2][0]) {
-        if (b[0][2] == AI) return +10;
-        else if (b[0][2] == HUMAN) return -10;
-    }
     return 0;
 }
 
+long long minimaxNodes = 0; // positions visited by minimax, for the harness
+
 // Minimax with alpha-beta pruning
 int minimax(vector<vector<char>> &board, int depth, bool isMax, int alpha, int beta) {
+    minimaxNodes++;
     int score = evaluate(board);
+    int n = board.size();
 
-    if (score == 10) return score - depth;     // AI win
-    if (score == -10) return score + depth;    // Human win
-    if (!isMovesLeft(board)) return 0;         // Draw
+    if (score == WIN_SCORE) return score - depth;  // AI win
+    if (score == -WIN_SCORE) return score + depth; // Human win
+    if (!isMovesLeft(board)) return 0;             // Draw
 
     if (isMax) { // AI's turn
         int best = -1000;
-        for (int i = 0; i < 3; i++) {
-            for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
                 if (board[i][j] == EMPTY) {
                     board[i][j] = AI;
                     best = max(best, minimax(board, depth + 1, !isMax, alpha, beta));
@@ -70,8 +101,8 @@ int minimax(vector<vector<char>> &board, int depth, bool isMax, int alpha, int b
         return best;
     } else { // Human's turn
         int best = 1000;
-        for (int i = 0; i < 3; i++) {
-            for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
                 if (board[i][j] == EMPTY) {
                     board[i][j] = HUMAN;
                     best = min(best, minimax(board, depth + 1, !isMax, alpha, beta));
@@ -89,9 +120,10 @@ int minimax(vector<vector<char>> &board, int depth, bool isMax, int alpha, int b
 Move findBestMove(vector<vector<char>> &board) {
     int bestVal = -1000;
     Move bestMove = {-1, -1};
+    int n = board.size();
 
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
             if (board[i][j] == EMPTY) {
                 board[i][j] = AI;
                 int moveVal = minimax(board, 0, false, -1000, 1000);
@@ -108,20 +140,986 @@ Move findBestMove(vector<vector<char>> &board) {
     return bestMove;
 }
 
+// ---------- Solved 3x3 table ----------
+// The classic game has only 3^9 encodable boards, so the value of every
+// position is computed at compile time and the AI move becomes one lookup.
+// Board index = sum of digit(cell) * 3^cell with cell = row * 3 + col and
+// digit 0 = EMPTY, 1 = AI, 2 = HUMAN. Placing a mark only ever increases the
+// index, so scanning indices downwards visits every child before its parent.
+namespace solved3 {
+
+constexpr int CELLS = 9;
+constexpr int STATES = 19683;
+
+struct Entry {
+    int8_t cell;   // AI's best cell as chosen by findBestMove, -1 if none
+    int16_t score; // findBestMove's bestVal for that move
+};
+
+struct Table {
+    Entry entry[STATES];
+};
+
+// Mirrors evaluate(): rows, then columns, then the two diagonals
+constexpr int evaluateDigits(const int (&d)[CELLS]) {
+    constexpr int lines[8][3] = {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}, {0, 3, 6},
+                                 {1, 4, 7}, {2, 5, 8}, {0, 4, 8}, {2, 4, 6}};
+    for (const auto &l : lines) {
+        if (d[l[0]] != 0 && d[l[0]] == d[l[1]] && d[l[1]] == d[l[2]])
+            return d[l[0]] == 1 ? 10 : -10;
+    }
+    return 0;
+}
+
+// One ply further from the root moves a win or loss one point towards 0,
+// exactly like minimax's depth adjustment.
+constexpr int shiftPly(int v) { return v > 0 ? v - 1 : v < 0 ? v + 1 : 0; }
+
+// valMax / valMin are the exact minimax values with AI / HUMAN to move,
+// relative to the position itself (depth 0), i.e. what
+// minimax(board, 0, isMax, -1000, 1000) returns.
+struct Values {
+    int8_t valMax[STATES];
+    int8_t valMin[STATES];
+};
+
+constexpr Values solveValues() {
+    Values v{};
+    int pow3[CELLS] = {};
+    for (int c = 0, p = 1; c < CELLS; c++, p *= 3) pow3[c] = p;
+
+    for (int idx = STATES - 1; idx >= 0; idx--) {
+        int d[CELLS] = {};
+        bool movesLeft = false;
+        for (int c = 0, x = idx; c < CELLS; c++, x /= 3) {
+            d[c] = x % 3;
+            if (d[c] == 0) movesLeft = true;
+        }
+        int score = evaluateDigits(d);
+        if (score != 0 || !movesLeft) {
+            v.valMax[idx] = v.valMin[idx] = int8_t(score);
+            continue;
+        }
+        int hi = -1000, lo = 1000;
+        for (int c = 0; c < CELLS; c++) {
+            if (d[c] != 0) continue;
+            hi = max(hi, shiftPly(v.valMin[idx + pow3[c]]));
+            lo = min(lo, shiftPly(v.valMax[idx + 2 * pow3[c]]));
+        }
+        v.valMax[idx] = int8_t(hi);
+        v.valMin[idx] = int8_t(lo);
+    }
+    return v;
+}
+
+constexpr Table buildTable() {
+    constexpr Values v = solveValues();
+    Table t{};
+    for (int idx = 0; idx < STATES; idx++) {
+        int bestVal = -1000, bestCell = -1;
+        for (int c = 0, p = 1, x = idx; c < CELLS; c++, p *= 3, x /= 3) {
+            if (x % 3 != 0) continue;
+            int moveVal = v.valMin[idx + p]; // same root scoring as findBestMove
+            if (moveVal > bestVal) { bestVal = moveVal; bestCell = c; }
+        }
+        t.entry[idx] = {int8_t(bestCell), int16_t(bestVal)};
+    }
+    return t;
+}
+
+constexpr Table TABLE = buildTable();
+
+// Empty board: every move draws, so findBestMove keeps the first one
+static_assert(TABLE.entry[0].cell == 0 && TABLE.entry[0].score == 0, "empty board");
+// X X _ / O O _ / _ _ _ : AI completes the top row
+static_assert(TABLE.entry[1 + 3 + 2 * 27 + 2 * 81].cell == 2 &&
+              TABLE.entry[1 + 3 + 2 * 27 + 2 * 81].score == 10, "immediate win");
+
+inline int boardIndex(vector<vector<char>> &board) {
+    int idx = 0;
+    for (int c = CELLS - 1; c >= 0; c--) {
+        char p = board[c / 3][c % 3];
+        idx = idx * 3 + (p == AI ? 1 : p == HUMAN ? 2 : 0);
+    }
+    return idx;
+}
+
+} // namespace solved3
+
+// Best move for AI on the classic 3x3 board by table lookup
+Move tableBestMove(vector<vector<char>> &board) {
+    const solved3::Entry &e = solved3::TABLE.entry[solved3::boardIndex(board)];
+    if (e.cell < 0) return {-1, -1};
+    return {e.cell / 3, e.cell % 3};
+}
+
+// Check the table against findBestMove on every encodable board
+int verifySolvedTable() {
+    int mismatches = 0;
+    vector<vector<char>> board(3, vector<char>(3, EMPTY));
+    for (int idx = 0; idx < solved3::STATES; idx++) {
+        for (int c = 0, x = idx; c < 9; c++, x /= 3)
+            board[c / 3][c % 3] = x % 3 == 1 ? AI : x % 3 == 2 ? HUMAN : EMPTY;
+
+        Move expect = findBestMove(board);
+        int expectVal = -1000;
+        if (expect.row >= 0) {
+            board[expect.row][expect.col] = AI;
+            expectVal = minimax(board, 0, false, -1000, 1000);
+            board[expect.row][expect.col] = EMPTY;
+        }
+        Move got = tableBestMove(board);
+        int gotVal = solved3::TABLE.entry[idx].score;
+        if (got.row != expect.row || got.col != expect.col || gotVal != expectVal) {
+            if (mismatches++ < 10)
+                cout << "mismatch at index " << idx << ": table " << got.row << "," << got.col
+                     << " (" << gotVal << "), minimax " << expect.row << "," << expect.col
+                     << " (" << expectVal << ")\n";
+        }
+    }
+    cout << "Checked " << solved3::STATES << " boards, " << mismatches << " mismatches.\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+// ---------- Parallel search (Lazy SMP) ----------
+// Every thread runs the same iterative-deepening alpha-beta from the root and
+// all of them share one lock-free transposition table. Helper threads start
+// at staggered depths with rotated root orders, so they fill the table with
+// entries the main thread can reuse. Only the main thread's answer is used,
+// which keeps a single-threaded search fully deterministic.
+
+// Lock-free table entry: `check` holds key ^ data, so a torn write from a
+// concurrent store simply fails verification instead of returning bad data.
+struct TTEntry {
+    atomic<uint64_t> check{0};
+    atomic<uint64_t> data{0};
+};
+
+enum TTFlag { TT_EXACT = 0, TT_LOWER = 1, TT_UPPER = 2 };
+
+class SharedTT {
+    unique_ptr<TTEntry[]> table;
+    uint64_t mask;
+public:
+    explicit SharedTT(int log2Size) : table(new TTEntry[size_t(1) << log2Size]),
+                                      mask((uint64_t(1) << log2Size) - 1) {}
+
+    bool probe(uint64_t key, uint64_t &data) const {
+        const TTEntry &e = table[key & mask];
+        uint64_t d = e.data.load(memory_order_relaxed);
+        uint64_t c = e.check.load(memory_order_relaxed);
+        if ((c ^ d) != key) return false;
+        data = d;
+        return true;
+    }
+
+    void store(uint64_t key, uint64_t data) {
+        TTEntry &e = table[key & mask];
+        e.check.store(key ^ data, memory_order_relaxed);
+        e.data.store(data, memory_order_relaxed);
+    }
+};
+
+// data layout: score (16 bits, biased) | flag (2) | draft (8) | move + 1 (10)
+static inline uint64_t packTT(int score, int flag, int draft, int cell) {
+    return uint64_t(score + 32768) | (uint64_t(flag) << 16) |
+           (uint64_t(draft) << 18) | (uint64_t(cell + 1) << 26);
+}
+static inline int ttScore(uint64_t d) { return int(d & 0xFFFF) - 32768; }
+static inline int ttFlag(uint64_t d)  { return int((d >> 16) & 3); }
+static inline int ttDraft(uint64_t d) { return int((d >> 18) & 0xFF); }
+static inline int ttMove(uint64_t d)  { return int((d >> 26) & 0x3FF) - 1; }
+
+// Win scores are depth-adjusted from the search root; the table stores them
+// relative to the node so an entry is valid at any ply.
+static inline int scoreToTT(int s, int ply)   { return s > 0 ? s + ply : s < 0 ? s - ply : 0; }
+static inline int scoreFromTT(int s, int ply) { return s > 0 ? s - ply : s < 0 ? s + ply : 0; }
+
+vector<uint64_t> zobrist[2]; // [AI / HUMAN][cell]
+uint64_t zobristSide;
+vector<int> moveOrder;       // cells sorted centre-first
+
+void initSearchTables() {
+    int cells = BOARD_N * BOARD_N;
+    mt19937_64 rng(20240917);
+    for (auto &z : zobrist) {
+        z.resize(cells);
+        for (auto &k : z) k = rng();
+    }
+    zobristSide = rng();
+
+    moveOrder.resize(cells);
+    iota(moveOrder.begin(), moveOrder.end(), 0);
+    double mid = (BOARD_N - 1) / 2.0;
+    stable_sort(moveOrder.begin(), moveOrder.end(), [&](int a, int b) {
+        double da = fabs(a / BOARD_N - mid) + fabs(a % BOARD_N - mid);
+        double db = fabs(b / BOARD_N - mid) + fabs(b % BOARD_N - mid);
+        return da < db;
+    });
+}
+
+// Does the mark at `cell` complete WIN_LEN in a row?
+static bool winsAt(const vector<char> &cells, int cell) {
+    static const int dr[4] = {0, 1, 1, 1};
+    static const int dc[4] = {1, 0, 1, -1};
+    int r = cell / BOARD_N, c = cell % BOARD_N;
+    char p = cells[cell];
+    for (int d = 0; d < 4; d++) {
+        int run = 1;
+        for (int s = -1; s <= 1; s += 2) {
+            int rr = r + s * dr[d], cc = c + s * dc[d];
+            while (rr >= 0 && rr < BOARD_N && cc >= 0 && cc < BOARD_N &&
+                   cells[rr * BOARD_N + cc] == p) {
+                run++;
+                rr += s * dr[d];
+                cc += s * dc[d];
+            }
+        }
+        if (run >= WIN_LEN) return true;
+    }
+    return false;
+}
+
+struct SearchWorker {
+    int id = 0;
+    vector<char> cells;
+    uint64_t hash = 0;
+    int empties = 0;
+    long long nodes = 0;
+    Move best = {-1, -1};
+    int bestVal = -1000;
+};
+
+struct SmpShared {
+    SharedTT tt;
+    atomic<bool> stop{false};
+    explicit SmpShared(int log2Size) : tt(log2Size) {}
+};
+
+// Same scoring as minimax(): wins are +/-(WIN_SCORE - ply), draws and the
+// search horizon score 0.
+static int smpSearch(SearchWorker &w, SmpShared &sh, int ply, int depthLeft,
+                     bool isMax, int alpha, int beta, int lastCell) {
+    w.nodes++;
+    if (winsAt(w.cells, lastCell))
+        return isMax ? -WIN_SCORE + ply : WIN_SCORE - ply;
+    if (w.empties == 0 || depthLeft == 0) return 0;
+    if (sh.stop.load(memory_order_relaxed)) return 0;
+
+    uint64_t key = w.hash ^ (isMax ? zobristSide : 0);
+    int hashMove = -1;
+    uint64_t d;
+    if (sh.tt.probe(key, d)) {
+        hashMove = ttMove(d);
+        if (ttDraft(d) >= depthLeft) {
+            int v = scoreFromTT(ttScore(d), ply);
+            if (ttFlag(d) == TT_EXACT) return v;
+            if (ttFlag(d) == TT_LOWER) alpha = max(alpha, v);
+            else beta = min(beta, v);
+            if (beta <= alpha) return v;
+        }
+    }
+
+    int alphaOrig = alpha, betaOrig = beta;
+    char mark = isMax ? AI : HUMAN;
+    int side = isMax ? 0 : 1;
+    int best = isMax ? -1000 : 1000, bestCell = -1;
+    int cells = BOARD_N * BOARD_N;
+
+    for (int k = -1; k < cells; k++) {
+        int cell = k < 0 ? hashMove : moveOrder[k];
+        if (cell < 0 || cell >= cells || w.cells[cell] != EMPTY || (k >= 0 && cell == hashMove)) continue;
+
+        w.cells[cell] = mark;
+        w.hash ^= zobrist[side][cell];
+        w.empties--;
+        int v = smpSearch(w, sh, ply + 1, depthLeft - 1, !isMax, alpha, beta, cell);
+        w.empties++;
+        w.hash ^= zobrist[side][cell];
+        w.cells[cell] = EMPTY;
+
+        if (isMax ? v > best : v < best) { best = v; bestCell = cell; }
+        if (isMax) alpha = max(alpha, best);
+        else beta = min(beta, best);
+        if (beta <= alpha) break;
+    }
+
+    // A stopped search returns partial results that must not reach the table
+    if (sh.stop.load(memory_order_relaxed)) return best;
+
+    int flag = best <= alphaOrig ? TT_UPPER : best >= betaOrig ? TT_LOWER : TT_EXACT;
+    sh.tt.store(key, packTT(scoreToTT(best, ply), flag, min(depthLeft, 255), bestCell));
+    return best;
+}
+
+// Iterative deepening from the root for one thread. Root moves are searched
+// with the same scoring as findBestMove (depth 0 at the child position).
+static void smpRoot(SearchWorker &w, SmpShared &sh, int maxDepth) {
+    int cells = BOARD_N * BOARD_N;
+    vector<int> rootMoves;
+    for (int cell : moveOrder)
+        if (w.cells[cell] == EMPTY) rootMoves.push_back(cell);
+    if (rootMoves.empty()) return;
+    if (w.id > 0) rotate(rootMoves.begin(), rootMoves.begin() + w.id % rootMoves.size(), rootMoves.end());
+
+    int startDepth = w.id == 0 ? 1 : 1 + (w.id & 1);
+    for (int depth = startDepth; depth <= maxDepth; depth++) {
+        int bestVal = -1000, bestCell = -1;
+        for (int cell : rootMoves) {
+            w.cells[cell] = AI;
+            w.hash ^= zobrist[0][cell];
+            w.empties--;
+            int v = smpSearch(w, sh, 0, depth - 1, false, bestVal, 1000, cell);
+            w.empties++;
+            w.hash ^= zobrist[0][cell];
+            w.cells[cell] = EMPTY;
+            if (sh.stop.load(memory_order_relaxed)) return;
+            if (v > bestVal) { bestVal = v; bestCell = cell; }
+        }
+        w.best = {bestCell / BOARD_N, bestCell % BOARD_N};
+        w.bestVal = bestVal;
+
+        // Search the best move first at the next depth
+        auto it = find(rootMoves.begin(), rootMoves.end(), bestCell);
+        rotate(rootMoves.begin(), it, it + 1);
+        // A proven win or a search to the end of the game cannot improve
+        if (abs(bestVal) > WIN_SCORE - cells || depth >= w.empties) break;
+    }
+}
+
+struct SmpResult {
+    Move move;
+    int score;
+    long long nodes;
+    double millis;
+};
+
+SmpResult parallelFindBestMove(vector<vector<char>> &board, int numThreads, int maxDepth) {
+    auto t0 = chrono::steady_clock::now();
+    int cells = BOARD_N * BOARD_N;
+    if (maxDepth <= 0) maxDepth = cells;
+
+    SearchWorker proto;
+    proto.cells.resize(cells);
+    for (int i = 0; i < cells; i++) {
+        char p = board[i / BOARD_N][i % BOARD_N];
+        proto.cells[i] = p;
+        if (p == AI) proto.hash ^= zobrist[0][i];
+        else if (p == HUMAN) proto.hash ^= zobrist[1][i];
+        else proto.empties++;
+    }
+
+    SmpShared shared(BOARD_N == 3 ? 12 : 20); // the 3x3 tree has < 6000 nodes
+    vector<SearchWorker> workers(numThreads, proto);
+    for (int i = 0; i < numThreads; i++) workers[i].id = i;
+
+    vector<thread> helpers;
+    for (int i = 1; i < numThreads; i++)
+        helpers.emplace_back(smpRoot, ref(workers[i]), ref(shared), maxDepth);
+    smpRoot(workers[0], shared, maxDepth);
+    shared.stop.store(true);
+    for (auto &t : helpers) t.join();
+
+    long long nodes = 0;
+    for (auto &w : workers) nodes += w.nodes;
+    auto t1 = chrono::steady_clock::now();
+    return {workers[0].best, workers[0].bestVal, nodes,
+            chrono::duration<double, milli>(t1 - t0).count()};
+}
+
+// ---------- Monte Carlo Tree Search (UCT) ----------
+// For boards where exhaustive search is hopeless. Nodes live in a fixed-size
+// arena and all children of a node are allocated as one contiguous block, so
+// a node needs only the index of its first child. Between moves the subtree
+// under the played moves is copied into a second arena and reused. With
+// several threads each one grows its own tree (root parallelism) and the
+// root visit counts are summed to pick the move.
+
+int MCTS_PLAYOUTS = 100000;     // playout budget per move (0 = unlimited)
+int MCTS_MILLIS = 0;            // time budget per move in ms (0 = unlimited)
+int MCTS_NODES = 1 << 20;       // arena capacity per tree
+const uint32_t EXPAND_VISITS = 4; // visits before a leaf's children are allocated
+const double UCT_C = 1.4;
+
+enum NodeState { NODE_UNKNOWN = 0, NODE_OPEN = 1, NODE_WON = 2, NODE_DRAWN = 3 };
+
+struct MctsNode {
+    uint32_t firstChild;      // arena index of the first child, NONE if unexpanded
+    uint32_t visits;
+    float wins;               // from the view of the player who made `cell`
+    int16_t cell;             // move leading to this node
+    uint16_t numChildren : 14;
+    uint16_t state : 2;       // NodeState: is the position after `cell` terminal?
+};
+
+class NodeArena {
+    vector<MctsNode> nodes;
+    size_t used = 0;
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    explicit NodeArena(size_t capacity) : nodes(capacity) {}
+
+    // Allocate `count` consecutive nodes; NONE when the arena is full
+    uint32_t alloc(size_t count) {
+        if (used + count > nodes.size()) return NONE;
+        uint32_t at = uint32_t(used);
+        used += count;
+        return at;
+    }
+
+    MctsNode &operator[](uint32_t i) { return nodes[i]; }
+    const MctsNode &operator[](uint32_t i) const { return nodes[i]; }
+    void reset() { used = 0; }
+    size_t size() const { return used; }
+};
+
+// Compact board for playouts: marks plus an unordered list of empty cells
+struct PlayoutBoard {
+    vector<char> cells;
+    vector<int16_t> empties;
+    vector<int16_t> pos; // index of each empty cell in `empties`
+
+    void load(vector<vector<char>> &board) {
+        int total = BOARD_N * BOARD_N;
+        cells.assign(total, EMPTY);
+        empties.clear();
+        pos.assign(total, -1);
+        for (int i = 0; i < total; i++) {
+            cells[i] = board[i / BOARD_N][i % BOARD_N];
+            if (cells[i] == EMPTY) {
+                pos[i] = int16_t(empties.size());
+                empties.push_back(int16_t(i));
+            }
+        }
+    }
+
+    void place(int cell, char mark) {
+        cells[cell] = mark;
+        int16_t i = pos[cell], last = empties.back();
+        empties[i] = last;
+        pos[last] = i;
+        empties.pop_back();
+        pos[cell] = -1;
+    }
+};
+
+// xorshift64*: playouts need speed, not statistical perfection
+struct FastRng {
+    uint64_t s;
+    explicit FastRng(uint64_t seed) : s(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+    uint64_t next() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 0x2545F4914F6CDD1DULL;
+    }
+    int below(int n) { return int((next() >> 32) * uint64_t(n) >> 32); }
+};
+
+static inline char opponent(char mark) { return mark == AI ? HUMAN : AI; }
+
+class MctsTree {
+    NodeArena arena, spare;
+    uint32_t root = 0;
+    PlayoutBoard rootBoard, scratch;
+    char rootToMove = AI;
+    FastRng rng;
+    vector<uint32_t> path;
+
+    void newRoot() {
+        arena.reset();
+        root = arena.alloc(1);
+        arena[root] = {NodeArena::NONE, 0, 0.0f, -1, 0, NODE_OPEN};
+    }
+
+    bool expand(uint32_t node, const PlayoutBoard &b) {
+        size_t count = b.empties.size();
+        uint32_t first = arena.alloc(count);
+        if (first == NodeArena::NONE) return false;
+        for (size_t i = 0; i < count; i++)
+            arena[first + i] = {NodeArena::NONE, 0, 0.0f, b.empties[i], 0, NODE_UNKNOWN};
+        arena[node].firstChild = first;
+        arena[node].numChildren = uint16_t(count);
+        return true;
+    }
+
+    uint32_t selectChild(uint32_t node) {
+        const MctsNode &n = arena[node];
+        double logN = log(double(n.visits) + 1.0);
+        uint32_t best = n.firstChild;
+        double bestScore = -1.0;
+        for (uint32_t c = n.firstChild; c < n.firstChild + n.numChildren; c++) {
+            const MctsNode &ch = arena[c];
+            if (ch.visits == 0) return c;
+            double score = ch.wins / ch.visits + UCT_C * sqrt(logN / ch.visits);
+            if (score > bestScore) { bestScore = score; best = c; }
+        }
+        return best;
+    }
+
+    // Random game to the end; returns the winning mark or EMPTY for a draw
+    char rollout(PlayoutBoard &b, char toMove) {
+        vector<int16_t> &free = b.empties;
+        while (!free.empty()) {
+            int i = rng.below(int(free.size()));
+            int cell = free[i];
+            free[i] = free.back();
+            free.pop_back();
+            b.cells[cell] = toMove;
+            if (winsAt(b.cells, cell)) return toMove;
+            toMove = opponent(toMove);
+        }
+        return EMPTY;
+    }
+
+    void iterate() {
+        scratch = rootBoard;
+        path.clear();
+        path.push_back(root);
+        uint32_t node = root;
+        char toMove = rootToMove;
+        char winner = EMPTY;
+
+        while (true) {
+            MctsNode &n = arena[node];
+            if (n.state == NODE_WON) { winner = opponent(toMove); break; }
+            if (n.state == NODE_DRAWN) break;
+            if ((n.visits < EXPAND_VISITS && node != root) ||
+                (n.firstChild == NodeArena::NONE && !expand(node, scratch))) {
+                winner = rollout(scratch, toMove);
+                break;
+            }
+            uint32_t child = selectChild(node);
+            MctsNode &ch = arena[child];
+            scratch.place(ch.cell, toMove);
+            if (ch.state == NODE_UNKNOWN)
+                ch.state = winsAt(scratch.cells, ch.cell) ? NODE_WON
+                         : scratch.empties.empty()        ? NODE_DRAWN
+                                                          : NODE_OPEN;
+            path.push_back(child);
+            node = child;
+            toMove = opponent(toMove);
+        }
+
+        // The node at depth d was entered by the root player when d is odd
+        char mover = opponent(rootToMove);
+        for (uint32_t p : path) {
+            MctsNode &n = arena[p];
+            n.visits++;
+            n.wins += winner == mover ? 1.0f : winner == EMPTY ? 0.5f : 0.0f;
+            mover = opponent(mover);
+        }
+    }
+
+    // Copy the subtree under `from` into the spare arena and make it current
+    void reroot(uint32_t from) {
+        spare.reset();
+        uint32_t top = spare.alloc(1);
+        spare[top] = arena[from];
+        vector<pair<uint32_t, uint32_t>> todo = {{from, top}};
+        while (!todo.empty()) {
+            auto [src, dst] = todo.back();
+            todo.pop_back();
+            const MctsNode &s = arena[src];
+            if (s.firstChild == NodeArena::NONE) continue;
+            uint32_t first = spare.alloc(s.numChildren);
+            spare[dst].firstChild = first;
+            for (uint32_t i = 0; i < s.numChildren; i++) {
+                spare[first + i] = arena[s.firstChild + i];
+                todo.push_back({s.firstChild + i, first + i});
+            }
+        }
+        swap(arena, spare);
+        root = top;
+    }
+
+public:
+    MctsTree(size_t capacity, uint64_t seed) : arena(capacity), spare(capacity), rng(seed) {}
+
+    void reset(vector<vector<char>> &board, char toMove) {
+        rootBoard.load(board);
+        rootToMove = toMove;
+        newRoot();
+    }
+
+    // Play `cell` at the root, keeping the statistics of the chosen subtree
+    void advance(int cell) {
+        rootBoard.place(cell, rootToMove);
+        rootToMove = opponent(rootToMove);
+        const MctsNode &r = arena[root];
+        for (uint32_t c = r.firstChild; r.firstChild != NodeArena::NONE && c < r.firstChild + r.numChildren; c++) {
+            if (arena[c].cell == cell) {
+                reroot(c);
+                return;
+            }
+        }
+        newRoot();
+    }
+
+    // Bring the tree in line with `board`. The previous root plus the root
+    // player's move and the reply is replayed to keep the subtree; anything
+    // else starts a fresh tree.
+    void sync(vector<vector<char>> &board, char toMove) {
+        int total = BOARD_N * BOARD_N;
+        if ((int)rootBoard.cells.size() != total) { reset(board, toMove); return; }
+        vector<int> mine, theirs; // new marks by the root player / the opponent
+        for (int i = 0; i < total; i++) {
+            char now = board[i / BOARD_N][i % BOARD_N], was = rootBoard.cells[i];
+            if (now == was) continue;
+            if (was != EMPTY) { reset(board, toMove); return; }
+            (now == rootToMove ? mine : theirs).push_back(i);
+        }
+        if (mine.size() > 1 || theirs.size() > mine.size()) { reset(board, toMove); return; }
+        if (!mine.empty()) advance(mine[0]);
+        if (!theirs.empty()) advance(theirs[0]);
+        if (rootToMove != toMove) reset(board, toMove);
+    }
+
+    long long search(long long playouts, chrono::steady_clock::time_point deadline, bool timed) {
+        long long done = 0;
+        while (playouts == 0 || done < playouts) {
+            if (timed && (done & 63) == 0 && chrono::steady_clock::now() >= deadline) break;
+            iterate();
+            done++;
+        }
+        return done;
+    }
+
+    // Root children as (cell, visits, wins)
+    void rootStats(vector<tuple<int, uint32_t, float>> &out) const {
+        const MctsNode &r = arena[root];
+        if (r.firstChild == NodeArena::NONE) return;
+        for (uint32_t c = r.firstChild; c < r.firstChild + r.numChildren; c++)
+            out.emplace_back(arena[c].cell, arena[c].visits, arena[c].wins);
+    }
+
+    size_t nodesUsed() const { return arena.size(); }
+};
+
+struct MctsReport {
+    long long playouts;
+    double millis;
+    size_t nodes;   // tree nodes in use over all threads
+    double winRate; // of the chosen move, for the player to move
+};
+
+// Root-parallel MCTS player: one tree per thread, kept across moves
+class MctsPlayer {
+    vector<unique_ptr<MctsTree>> trees;
+public:
+    explicit MctsPlayer(int threads) {
+        for (int i = 0; i < threads; i++)
+            trees.push_back(make_unique<MctsTree>(MCTS_NODES, 0x5EEDULL * (i + 1)));
+    }
+
+    Move chooseMove(vector<vector<char>> &board, char toMove, MctsReport &rep) {
+        auto t0 = chrono::steady_clock::now();
+        auto deadline = t0 + chrono::milliseconds(MCTS_MILLIS);
+        int numThreads = trees.size();
+        long long budget = MCTS_PLAYOUTS > 0 ? (MCTS_PLAYOUTS + numThreads - 1) / numThreads : 0;
+
+        vector<long long> done(numThreads, 0);
+        vector<thread> helpers;
+        for (int i = 0; i < numThreads; i++) trees[i]->sync(board, toMove);
+        for (int i = 1; i < numThreads; i++)
+            helpers.emplace_back([&, i] { done[i] = trees[i]->search(budget, deadline, MCTS_MILLIS > 0); });
+        done[0] = trees[0]->search(budget, deadline, MCTS_MILLIS > 0);
+        for (auto &t : helpers) t.join();
+
+        map<int, pair<double, double>> merged; // cell -> (visits, wins)
+        vector<tuple<int, uint32_t, float>> stats;
+        for (auto &t : trees) {
+            stats.clear();
+            t->rootStats(stats);
+            for (auto &[cell, visits, wins] : stats) {
+                merged[cell].first += visits;
+                merged[cell].second += wins;
+            }
+        }
+        int bestCell = -1;
+        double bestVisits = -1, bestWins = 0;
+        for (auto &[cell, vw] : merged)
+            if (vw.first > bestVisits) { bestVisits = vw.first; bestWins = vw.second; bestCell = cell; }
+
+        rep = {0, 0, 0, bestVisits > 0 ? bestWins / bestVisits : 0};
+        for (int i = 0; i < numThreads; i++) {
+            rep.playouts += done[i];
+            rep.nodes += trees[i]->nodesUsed();
+        }
+        rep.millis = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+        if (bestCell < 0) return {-1, -1};
+        for (auto &t : trees) t->advance(bestCell);
+        return {bestCell / BOARD_N, bestCell % BOARD_N};
+    }
+};
+
 // Print board
 void printBoard(vector<vector<char>> &board) {
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++)
+    int n = board.size();
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++)
             cout << board[i][j] << " ";
         cout << endl;
     }
 }
 
-int main() {
-    vector<vector<char>> board(3, vector<char>(3, EMPTY));
+// Set the board geometry; returns false for unsupported sizes
+bool setGeometry(int n, int k) {
+    if (n < 3 || n > 19 || k < 3 || k > n) return false;
+    BOARD_N = n;
+    WIN_LEN = k;
+    WIN_SCORE = max(10, n * n + 1); // depth adjustment must never flip a win
+    initSearchTables();
+    return true;
+}
+
+// Nodes/sec scaling of the parallel search for 1..maxThreads threads
+int runSmpBenchmark(int maxThreads, int depth) {
+    vector<vector<char>> board(BOARD_N, vector<char>(BOARD_N, EMPTY));
+    cout << "Lazy SMP scaling: " << BOARD_N << "x" << BOARD_N << ", " << WIN_LEN
+         << " in a row, depth " << (depth > 0 ? to_string(depth) : "full") << "\n";
+    cout << "threads        nodes       ms      knps  speedup  move   score\n";
+    double base = 0;
+    for (int t = 1; t <= maxThreads; t++) {
+        SmpResult r = parallelFindBestMove(board, t, depth);
+        double knps = r.millis > 0 ? r.nodes / r.millis : 0;
+        if (t == 1) base = r.millis;
+        cout << setw(7) << t << setw(13) << r.nodes << setw(9) << fixed << setprecision(1)
+             << r.millis << setw(10) << setprecision(0) << knps << setw(9) << setprecision(2)
+             << (r.millis > 0 ? base / r.millis : 0) << "  " << r.move.row << "," << r.move.col
+             << setw(8) << r.score << "\n";
+    }
+    return 0;
+}
+
+// ---------- Perft and self-play harness ----------
+// Non-interactive checks of the engine. perft counts the positions exactly
+// `depth` plies from the empty board (a won game is not extended), once with
+// evaluate()/isMovesLeft() and once with the incremental winsAt() used by
+// the fast searches; the two must agree. selfplay runs engine-vs-engine
+// games and prints one JSON object with outcomes and per-engine throughput.
+
+long long perft(vector<vector<char>> &board, int depth, char toMove) {
+    if (depth == 0) return 1;
+    if (evaluate(board) != 0 || !isMovesLeft(board)) return 0;
+    long long count = 0;
+    int n = board.size();
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (board[i][j] != EMPTY) continue;
+            board[i][j] = toMove;
+            count += perft(board, depth - 1, opponent(toMove));
+            board[i][j] = EMPTY;
+        }
+    }
+    return count;
+}
+
+long long perftFast(PlayoutBoard &b, int depth, char toMove, int lastCell) {
+    if (depth == 0) return 1;
+    if ((lastCell >= 0 && winsAt(b.cells, lastCell)) || b.empties.empty()) return 0;
+    long long count = 0;
+    for (int cell = 0; cell < BOARD_N * BOARD_N; cell++) {
+        if (b.cells[cell] != EMPTY) continue;
+        b.place(cell, toMove);
+        count += perftFast(b, depth - 1, opponent(toMove), cell);
+        // undo: put the cell back on the empty list
+        b.cells[cell] = EMPTY;
+        b.pos[cell] = int16_t(b.empties.size());
+        b.empties.push_back(int16_t(cell));
+    }
+    return count;
+}
+
+int runPerft(int maxDepth) {
+    // Reference counts for the classic 3x3 game (255168 games in total)
+    static const long long classic[10] = {1, 9, 72, 504, 3024, 15120, 54720, 148176, 200448, 127872};
+    bool allOk = true;
+    vector<vector<char>> board(BOARD_N, vector<char>(BOARD_N, EMPTY));
+    PlayoutBoard fast;
+    fast.load(board);
+    for (int d = 1; d <= maxDepth && d <= BOARD_N * BOARD_N; d++) {
+        auto t0 = chrono::steady_clock::now();
+        long long nodes = perft(board, d, AI);
+        auto t1 = chrono::steady_clock::now();
+        long long check = perftFast(fast, d, AI, -1);
+        double ms = chrono::duration<double, milli>(t1 - t0).count();
+        bool ok = nodes == check;
+        bool classicBoard = BOARD_N == 3 && WIN_LEN == 3;
+        if (classicBoard) ok = ok && nodes == classic[d];
+        allOk = allOk && ok;
+        cout << "{\"mode\":\"perft\",\"size\":" << BOARD_N << ",\"win\":" << WIN_LEN
+             << ",\"depth\":" << d << ",\"nodes\":" << nodes << ",\"fast_nodes\":" << check;
+        if (classicBoard) cout << ",\"expected\":" << classic[d];
+        cout << ",\"ms\":" << fixed << setprecision(3) << ms << ",\"nodes_per_sec\":" << setprecision(0)
+             << (ms > 0 ? nodes * 1000.0 / ms : 0) << ",\"ok\":" << (ok ? "true" : "false") << "}\n";
+    }
+    return allOk ? 0 : 1;
+}
+
+// A self-play engine: "table", "minimax", "smp[:depth]", "mcts[:playouts]"
+// or "random". Searches written from the AI's side play O on a board with
+// the marks swapped.
+struct Engine {
+    string kind;
+    int param = 0;
+    unique_ptr<MctsPlayer> mcts;
+    FastRng rng{1};
+    long long nodes = 0; // searched positions (playouts for mcts)
+    vector<double> latencies;
+};
+
+bool parseEngine(const string &spec, Engine &e) {
+    size_t colon = spec.find(':');
+    e.kind = spec.substr(0, colon);
+    e.param = colon == string::npos ? 0 : max(0, atoi(spec.c_str() + colon + 1));
+    if (e.kind == "table") return BOARD_N == 3 && WIN_LEN == 3;
+    if (e.kind == "mcts") {
+        if (e.param == 0) e.param = MCTS_PLAYOUTS;
+        e.mcts = make_unique<MctsPlayer>(SEARCH_THREADS);
+        return true;
+    }
+    return e.kind == "minimax" || e.kind == "smp" || e.kind == "random";
+}
+
+Move engineMove(Engine &e, vector<vector<char>> &board, char toMove) {
+    auto t0 = chrono::steady_clock::now();
+    Move m = {-1, -1};
+    if (e.kind == "random") {
+        vector<Move> free;
+        for (int i = 0; i < BOARD_N; i++)
+            for (int j = 0; j < BOARD_N; j++)
+                if (board[i][j] == EMPTY) free.push_back({i, j});
+        m = free[e.rng.below(free.size())];
+    } else if (e.kind == "mcts") {
+        MctsReport rep;
+        int saved = MCTS_PLAYOUTS;
+        MCTS_PLAYOUTS = e.param;
+        m = e.mcts->chooseMove(board, toMove, rep);
+        MCTS_PLAYOUTS = saved;
+        e.nodes += rep.playouts;
+    } else {
+        vector<vector<char>> view = board;
+        if (toMove == HUMAN)
+            for (auto &row : view)
+                for (auto &c : row) c = c == AI ? HUMAN : c == HUMAN ? AI : EMPTY;
+        if (e.kind == "table") {
+            m = tableBestMove(view);
+        } else if (e.kind == "minimax") {
+            long long before = minimaxNodes;
+            m = findBestMove(view);
+            e.nodes += minimaxNodes - before;
+        } else {
+            SmpResult r = parallelFindBestMove(view, SEARCH_THREADS, e.param);
+            m = r.move;
+            e.nodes += r.nodes;
+        }
+    }
+    e.latencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+    return m;
+}
+
+static void printEngineJson(const string &spec, Engine &e) {
+    vector<double> lat = e.latencies;
+    sort(lat.begin(), lat.end());
+    double total = accumulate(lat.begin(), lat.end(), 0.0);
+    double avg = lat.empty() ? 0 : total / lat.size();
+    double p99 = lat.empty() ? 0 : lat[size_t(ceil(0.99 * lat.size())) - 1];
+    cout << "{\"engine\":\"" << spec << "\",\"moves\":" << lat.size() << ",\"nodes\":" << e.nodes
+         << ",\"nodes_per_sec\":" << fixed << setprecision(0) << (total > 0 ? e.nodes * 1000.0 / total : 0)
+         << ",\"avg_move_ms\":" << setprecision(3) << avg << ",\"p99_move_ms\":" << p99 << "}";
+}
+
+// X moves first; the first `randomPlies` moves are random so games differ
+int runSelfPlay(int games, const string &xSpec, const string &oSpec, uint64_t seed, int randomPlies) {
+    Engine engines[2];
+    if (!parseEngine(xSpec, engines[0]) || !parseEngine(oSpec, engines[1])) {
+        cerr << "Unknown engine (expected table, minimax, smp[:depth], mcts[:playouts] or random;"
+                " table needs the 3x3 board).\n";
+        return 1;
+    }
+    engines[0].rng = FastRng(seed * 2 + 1);
+    engines[1].rng = FastRng(seed * 2 + 2);
+    FastRng opening(seed);
+
+    int xWins = 0, oWins = 0, draws = 0;
+    long long plies = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (int g = 0; g < games; g++) {
+        vector<vector<char>> board(BOARD_N, vector<char>(BOARD_N, EMPTY));
+        char toMove = AI;
+        for (int ply = 0; isMovesLeft(board) && evaluate(board) == 0; ply++, plies++) {
+            Move m;
+            if (ply < randomPlies) {
+                vector<Move> free;
+                for (int i = 0; i < BOARD_N; i++)
+                    for (int j = 0; j < BOARD_N; j++)
+                        if (board[i][j] == EMPTY) free.push_back({i, j});
+                m = free[opening.below(free.size())];
+            } else {
+                m = engineMove(engines[toMove == AI ? 0 : 1], board, toMove);
+            }
+            board[m.row][m.col] = toMove;
+            toMove = opponent(toMove);
+        }
+        int score = evaluate(board);
+        if (score == WIN_SCORE) xWins++;
+        else if (score == -WIN_SCORE) oWins++;
+        else draws++;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+    cout << "{\"mode\":\"selfplay\",\"size\":" << BOARD_N << ",\"win\":" << WIN_LEN << ",\"games\":" << games
+         << ",\"seed\":" << seed << ",\"random_plies\":" << randomPlies << ",\"plies\":" << plies
+         << ",\"x_wins\":" << xWins << ",\"o_wins\":" << oWins << ",\"draws\":" << draws
+         << ",\"total_ms\":" << fixed << setprecision(3) << ms << ",\"x\":";
+    printEngineJson(xSpec, engines[0]);
+    cout << ",\"o\":";
+    printEngineJson(oSpec, engines[1]);
+    cout << "}\n";
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    string mode = argc >= 2 ? argv[1] : "play";
+    int n = argc >= 3 ? atoi(argv[2]) : 3;
+    int k = argc >= 4 ? atoi(argv[3]) : n;
+    if (mode == "verify") return verifySolvedTable();
+    if (mode != "play" && mode != "smp" && mode != "mcts" && mode != "perft" && mode != "selfplay") {
+        cerr << "Unrecognized mode '" << mode << "' (expected play, smp, mcts, perft, selfplay or verify).\n";
+        return 1;
+    }
+    if (!setGeometry(n, k)) {
+        cerr << "Unsupported board: size must be 3..19 and win length 3..size.\n";
+        return 1;
+    }
+    if (mode == "perft") return runPerft(argc >= 5 ? atoi(argv[4]) : n * n);
+    if (mode == "selfplay")
+        return runSelfPlay(argc >= 5 ? max(1, atoi(argv[4])) : 100, argc >= 6 ? argv[5] : "minimax",
+                           argc >= 7 ? argv[6] : "random", argc >= 8 ? strtoull(argv[7], nullptr, 10) : 1,
+                           argc >= 9 ? max(0, atoi(argv[8])) : 2);
+    if (argc >= 5) SEARCH_THREADS = max(1, atoi(argv[4]));
+    if (mode == "mcts") {
+        if (argc >= 6) MCTS_PLAYOUTS = max(0, atoi(argv[5]));
+        if (argc >= 7) MCTS_MILLIS = max(0, atoi(argv[6]));
+        if (argc >= 8) MCTS_NODES = max(1024, atoi(argv[7]));
+        if (MCTS_PLAYOUTS == 0 && MCTS_MILLIS == 0) MCTS_PLAYOUTS = 100000;
+    } else if (argc >= 6) {
+        SEARCH_DEPTH = max(0, atoi(argv[5]));
+    }
+
+    if (mode == "smp")
+        return runSmpBenchmark(argc >= 5 ? SEARCH_THREADS : max(1u, thread::hardware_concurrency()),
+                               SEARCH_DEPTH);
+
+    vector<vector<char>> board(BOARD_N, vector<char>(BOARD_N, EMPTY));
     int x, y;
+    unique_ptr<MctsPlayer> mcts;
+    if (mode == "mcts") mcts = make_unique<MctsPlayer>(SEARCH_THREADS);
 
-    cout << "Tic-Tac-Toe using Minimax (AI = X, You = O)\n";
+    cout << "Tic-Tac-Toe using " << (mcts ? "MCTS" : "Minimax") << " (AI = X, You = O)\n";
 
     while (true) {
         printBoard(board);
@@ -129,8 +1127,8 @@ int main() {
         if (!isMovesLeft(board) || evaluate(board) != 0) break;
 
         cout << "Enter your move (row col): ";
-        cin >> x >> y;
-        if (x >= 0 && x < 3 && y >= 0 && y < 3 && board[x][y] == EMPTY)
+        if (!(cin >> x >> y)) return 0;
+        if (x >= 0 && x < BOARD_N && y >= 0 && y < BOARD_N && board[x][y] == EMPTY)
             board[x][y] = HUMAN;
         else {
             cout << "Invalid move! Try again.\n";
@@ -139,14 +1137,25 @@ int main() {
 
         if (!isMovesLeft(board) || evaluate(board) != 0) break;
 
-        Move bestMove = findBestMove(board);
+        Move bestMove;
+        if (mcts) {
+            MctsReport rep;
+            bestMove = mcts->chooseMove(board, AI, rep);
+            cout << "MCTS: " << rep.playouts << " playouts in " << fixed << setprecision(1)
+                 << rep.millis << " ms (" << setprecision(0)
+                 << (rep.millis > 0 ? rep.playouts * 1000.0 / rep.millis : 0) << " playouts/sec), "
+                 << rep.nodes << " tree nodes, win rate " << setprecision(2) << rep.winRate << "\n";
+        } else if (BOARD_N == 3 && SEARCH_THREADS == 1 && SEARCH_DEPTH == 0)
+            bestMove = tableBestMove(board);
+        else
+            bestMove = parallelFindBestMove(board, SEARCH_THREADS, SEARCH_DEPTH).move;
         board[bestMove.row][bestMove.col] = AI;
     }
 
     printBoard(board);
     int score = evaluate(board);
-    if (score == 10) cout << "AI Wins!\n";
-    else if (score == -10) cout << "You Win!\n";
+    if (score == WIN_SCORE) cout << "AI Wins!\n";
+    else if (score == -WIN_SCORE) cout << "You Win!\n";
     else cout << "It's a Draw!\n";
 
     return 0;
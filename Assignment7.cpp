@@ -1,13 +1,34 @@
 #include <bits/stdc++.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 /*
- * Forward Chaining over propositional Horn rules.
+ * Forward Chaining over Horn rules: propositional symbols, ground atoms such
+ * as parent(alice,bob), and first-order rules whose arguments may be
+ * variables (?x).
+ * Usage:
+ *   Assignment7           # interactive, commands below
+ *   Assignment7 verify    # check backward answers on cyclic rule sets
+ *                         # against run(), under a fixed time limit
  * Input (interactive):
  *   fact X
  *   rule A & B -> C
+ *   rule parent(?x,?y) & parent(?y,?z) -> grandparent(?x,?z)
  *   run
- *   ask X
+ *   ask X              (also ask parent(?x, bob) for all answers)
+ *   prove X            (proof tree)
+ *   retract X
+ *   incremental on|off
+ *   load-kb FILE       (bulk load of fact/rule lines)
+ *   quiet on|off       (do not print each derived fact)
+ *   profile on|off     (per-rule timing for stats)
+ *   stats [json [FILE]] / stats reset
+ *   save FILE / load FILE   (binary snapshot)
  *   show
  *   exit
  * Example:
@@ -17,25 +38,1859 @@ using namespace std;
  *   rule has_hair -> mammal
  *   run
  *   ask monotreme
+ *
+ * Symbols are interned to integer ids when parsed. Each rule keeps a count
+ * of antecedents not yet propagated and is listed under each of its
+ * antecedents, so propagating a fact only touches the rules that mention it
+ * (Dowling-Gallier): inference is linear in the size of the knowledge base.
+ *
+ * In incremental mode every new fact or rule is propagated at once. Retract
+ * removes an asserted fact with DRed (delete and rederive): everything that
+ * was derived through it is deleted, then any deleted fact that still has a
+ * rule with all antecedents true is restored, so exactly the conclusions
+ * that depended on the retracted fact disappear.
+ *
+ * ask and prove do not need a prior run: they chain backwards from the goal
+ * and only evaluate the subgoals it depends on (see BackwardChainer).
  */
 
+static string trim(string s) {
+    auto issp = [](char c){ return isspace((unsigned char)c); };
+    while(!s.empty() && issp(s.front())) s.erase(s.begin());
+    while(!s.empty() && issp(s.back())) s.pop_back();
+    return s;
+}
+
+// An atom as written: name or name(arg, ...); '?x' arguments are variables
+struct ParsedAtom {
+    string name;
+    vector<string> args;
+};
+
+static string_view trimView(string_view v) {
+    while (!v.empty() && isspace((unsigned char)v.front())) v.remove_prefix(1);
+    while (!v.empty() && isspace((unsigned char)v.back())) v.remove_suffix(1);
+    return v;
+}
+
+// Split an atom into views of its name and arguments, without copying
+static bool splitAtom(string_view t, string_view &name, vector<string_view> &args) {
+    t = trimView(t);
+    args.clear();
+    size_t open = t.find('(');
+    if (open == string_view::npos) {
+        name = t;
+    } else {
+        if (t.back() != ')') return false;
+        name = trimView(t.substr(0, open));
+        string_view inner = t.substr(open + 1, t.size() - open - 2);
+        while (!inner.empty()) { // a trailing comma ends the list
+            size_t comma = inner.find(',');
+            args.push_back(trimView(inner.substr(0, comma)));
+            if (args.back().empty()) return false;
+            inner = comma == string_view::npos ? string_view() : inner.substr(comma + 1);
+        }
+        if (args.empty()) return false;
+    }
+    if (name.empty()) return false;
+    for (char c : name) // plain symbols may keep inner spaces ("has hair")
+        if ((isspace((unsigned char)c) && open != string_view::npos) || c == '(' || c == ')' ||
+            c == ',' || c == '?')
+            return false;
+    for (auto &a : args)
+        for (char c : a)
+            if (isspace((unsigned char)c) || c == '(' || c == ')') return false;
+    return true;
+}
+
+static bool parseAtom(const string &text, ParsedAtom &out) {
+    string_view name;
+    vector<string_view> args;
+    if (!splitAtom(text, name, args)) return false;
+    out.name = string(name);
+    out.args.assign(args.begin(), args.end());
+    return true;
+}
+
+static bool isVariable(const string &arg) { return arg[0] == '?'; }
+
+static bool hasVariables(const ParsedAtom &a) {
+    return any_of(a.args.begin(), a.args.end(), isVariable);
+}
+
+// Canonical spelling, used as the interned symbol of a ground atom
+static string canonical(const ParsedAtom &a) {
+    string s = a.name;
+    for (size_t i = 0; i < a.args.size(); i++) s += (i ? "," : "(") + a.args[i];
+    if (!a.args.empty()) s += ")";
+    return s;
+}
+
+// Rough heap footprint of containers, for the stats report
+template <class T> static size_t bytesOf(const vector<T> &v) { return v.capacity() * sizeof(T); }
+static size_t bytesOf(const vector<vector<int>> &v) {
+    size_t b = v.capacity() * sizeof(vector<int>);
+    for (auto &inner : v) b += bytesOf(inner);
+    return b;
+}
+template <class Map> static size_t mapBytes(const Map &m) {
+    // bucket array plus one node (value and next pointer) per element
+    return m.bucket_count() * sizeof(void *) + m.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void *));
+}
+
+// Read-only view of a whole file; memory-mapped where the platform allows
+class MappedFile {
+    const char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    string buffer;
+#else
+    void *mapping = nullptr;
+#endif
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const string &path) {
+#ifdef _WIN32
+        ifstream in(path, ios::binary);
+        if (!in) return false;
+        buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+        size = st.st_size;
+        if (size > 0) {
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) { mapping = nullptr; ::close(fd); return false; }
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(mapping);
+        }
+        ::close(fd);
+        return true;
+#endif
+    }
+
+    string_view view() const { return string_view(data ? data : "", size); }
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (mapping) munmap(mapping, size);
+#endif
+    }
+};
+
+// ---------- Binary snapshots ----------
+// Magic and version, then every table as a length-prefixed array in native
+// byte order; lists of lists are stored as offsets plus values and strings
+// as offsets plus one character blob, so loading is a handful of reads.
+const char SNAPSHOT_MAGIC[4] = {'F', 'C', 'K', 'B'};
+const uint64_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotWriter {
+    FILE *f;
+    bool ok = true;
+
+    void raw(const void *p, size_t n) {
+        if (n && fwrite(p, 1, n, f) != n) ok = false;
+    }
+    void u64(uint64_t v) { raw(&v, sizeof v); }
+    template <class T> void array(const vector<T> &v) {
+        u64(v.size());
+        raw(v.data(), v.size() * sizeof(T));
+    }
+    void nested(const vector<vector<int>> &v) {
+        vector<uint64_t> offsets = {0};
+        vector<int> values;
+        for (auto &inner : v) {
+            values.insert(values.end(), inner.begin(), inner.end());
+            offsets.push_back(values.size());
+        }
+        array(offsets);
+        array(values);
+    }
+    template <class Strings> void strings(const Strings &v) {
+        vector<uint64_t> offsets = {0};
+        vector<char> blob;
+        for (auto &str : v) {
+            blob.insert(blob.end(), str.begin(), str.end());
+            offsets.push_back(blob.size());
+        }
+        array(offsets);
+        array(blob);
+    }
+};
+
+struct SnapshotReader {
+    FILE *f;
+    uint64_t left; // bytes not read yet; no array can be longer
+    bool ok = true;
+
+    void raw(void *p, size_t n) {
+        if (ok && n && (n > left || fread(p, 1, n, f) != n)) ok = false;
+        if (ok) left -= n;
+    }
+    uint64_t u64() {
+        uint64_t v = 0;
+        raw(&v, sizeof v);
+        return v;
+    }
+    template <class T> void array(vector<T> &v) {
+        uint64_t n = u64();
+        if (!ok || n > left / sizeof(T)) { ok = false; return; }
+        v.resize(n);
+        raw(v.data(), n * sizeof(T));
+    }
+    void nested(vector<vector<int>> &v) {
+        vector<uint64_t> offsets;
+        vector<int> values;
+        array(offsets);
+        array(values);
+        v.clear();
+        for (size_t i = 0; ok && i + 1 < offsets.size(); i++) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > values.size()) { ok = false; break; }
+            v.emplace_back(values.begin() + offsets[i], values.begin() + offsets[i + 1]);
+        }
+    }
+    template <class Strings> void strings(Strings &v) {
+        vector<uint64_t> offsets;
+        vector<char> blob;
+        array(offsets);
+        array(blob);
+        v.clear();
+        for (size_t i = 0; ok && i + 1 < offsets.size(); i++) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > blob.size()) { ok = false; break; }
+            v.emplace_back(blob.begin() + offsets[i], blob.begin() + offsets[i + 1]);
+        }
+    }
+};
+
+// ---------- Rete network for first-order rules ----------
+// Each new fact is matched only against the partial matches it can extend:
+//  - an alpha memory holds the facts matching one pattern (predicate,
+//    constant arguments, repeated variables); equal patterns share it;
+//  - a join node extends the tokens (partial matches) of its parent with the
+//    facts of an alpha memory; both sides are hash-indexed on the variables
+//    the join tests, and rules starting with the same patterns share nodes;
+//  - a complete match is reported as (production, token). The knowledge base
+//    turns it into a ground rule instance, so counting and retraction work
+//    exactly as for hand-written rules.
+
+struct Pattern {
+    int pred;
+    vector<int> args; // >= 0: constant symbol id, < 0: variable slot -(s + 1)
+};
+
+struct AlphaMemory {
+    int pred;
+    vector<pair<int, int>> constTests; // (argument, symbol)
+    vector<pair<int, int>> sameTests;  // (argument, earlier argument) for a repeated variable
+    vector<int> facts;
+    unordered_map<int, int> where;     // fact -> index in facts
+    vector<int> successors;            // join nodes reading this memory
+};
+
+struct Token {
+    int parent, fact;
+    bool dead;               // removed; the slot is on the free list
+    vector<int> slots;       // variable bindings so far
+    vector<int> children;
+    int node = -1, pos = -1; // join node it ends at, index in its tokens
+};
+
+struct JoinNode {
+    int parent, alpha;             // parent join node, -1 for the root
+    vector<pair<int, int>> tests;  // (slot bound earlier, argument) that must agree
+    vector<pair<int, int>> binds;  // (argument, slot) first bound here
+    int numSlots;
+    unordered_map<uint64_t, vector<int>> leftIndex;  // join key -> parent tokens
+    unordered_map<uint64_t, vector<int>> rightIndex; // join key -> alpha facts
+    vector<int> tokens;            // partial matches ending here
+    vector<int> children, productions;
+    uint64_t activations = 0;      // left and right activations
+    double seconds = 0;            // in right activations starting here (profiling only)
+};
+
+struct Rete {
+    vector<AlphaMemory> alphas;
+    vector<JoinNode> joins;
+    vector<Token> tokens{Token{-1, -1, false, {}, {}}}; // tokens[0] is the root token
+    vector<int> freeTokens;                              // dead slots to reuse
+    vector<int> productionNode;
+    vector<vector<int>> alphasByPred;
+    unordered_map<int, vector<int>> tokensByFact;        // tokens whose last fact it is
+    map<string, int> sharedAlpha, sharedJoin;            // structural keys for sharing
+    vector<pair<int, int>> matches;                      // (production, token) not yet consumed
+    bool profiling = false;
+
+    // Supplied by the knowledge base: arguments of a fact, and the facts of a
+    // predicate that are already true (to fill new memories)
+    function<const vector<int> &(int fact)> argsOf;
+    function<vector<int>(int pred)> factsOf;
+
+    static uint64_t mix(uint64_t h, int v) { return (h ^ uint64_t(uint32_t(v))) * 0x100000001B3ULL; }
+
+    uint64_t leftKey(const JoinNode &j, int t) const {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (auto &[slot, arg] : j.tests) h = mix(h, tokens[t].slots[slot]);
+        return h;
+    }
+    static uint64_t rightKey(const JoinNode &j, const vector<int> &args) {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (auto &[slot, arg] : j.tests) h = mix(h, args[arg]);
+        return h;
+    }
+    bool consistent(const JoinNode &j, int t, const vector<int> &args) const {
+        for (auto &[slot, arg] : j.tests)
+            if (tokens[t].slots[slot] != args[arg]) return false;
+        return true;
+    }
+    static bool alphaMatches(const AlphaMemory &a, const vector<int> &args) {
+        for (auto &[arg, sym] : a.constTests)
+            if (args[arg] != sym) return false;
+        for (auto &[arg, other] : a.sameTests)
+            if (args[arg] != args[other]) return false;
+        return true;
+    }
+
+    void emit(int j, int parentToken, int fact, const vector<int> &args) {
+        int id;
+        if (!freeTokens.empty()) {
+            id = freeTokens.back();
+            freeTokens.pop_back();
+        } else {
+            id = tokens.size();
+            tokens.emplace_back();
+        }
+        Token &nt = tokens[id];
+        nt.parent = parentToken;
+        nt.fact = fact;
+        nt.dead = false;
+        nt.slots = tokens[parentToken].slots;
+        nt.slots.resize(joins[j].numSlots);
+        for (auto &[arg, slot] : joins[j].binds) nt.slots[slot] = args[arg];
+        nt.node = j;
+        nt.pos = joins[j].tokens.size();
+        // The root token is never removed, so it does not track children
+        if (parentToken != 0) tokens[parentToken].children.push_back(id);
+        joins[j].tokens.push_back(id);
+        tokensByFact[fact].push_back(id);
+        for (int c : joins[j].children) leftActivate(c, id);
+        for (int p : joins[j].productions) matches.push_back({p, id});
+    }
+
+    void leftActivate(int j, int t) {
+        joins[j].activations++;
+        uint64_t key = leftKey(joins[j], t);
+        joins[j].leftIndex[key].push_back(t);
+        auto it = joins[j].rightIndex.find(key);
+        if (it == joins[j].rightIndex.end()) return;
+        const vector<int> &facts = it->second;
+        for (size_t i = 0; i < facts.size(); i++) {
+            const vector<int> &args = argsOf(facts[i]);
+            if (consistent(joins[j], t, args)) emit(j, t, facts[i], args);
+        }
+    }
+
+    void rightActivate(int j, int fact, const vector<int> &args) {
+        joins[j].activations++;
+        uint64_t key = rightKey(joins[j], args);
+        joins[j].rightIndex[key].push_back(fact);
+        auto it = joins[j].leftIndex.find(key);
+        if (it == joins[j].leftIndex.end()) return;
+        const vector<int> &left = it->second;
+        for (size_t i = 0; i < left.size(); i++) {
+            int t = left[i];
+            if (!tokens[t].dead && consistent(joins[j], t, args)) emit(j, t, fact, args);
+        }
+    }
+
+
+    // A fact became true (and was propagated)
+    void addFact(int fact, int pred, const vector<int> &args) {
+        if (pred >= (int)alphasByPred.size()) return;
+        for (int a : alphasByPred[pred]) {
+            AlphaMemory &am = alphas[a];
+            if (!alphaMatches(am, args) || am.where.count(fact)) continue;
+            am.where[fact] = am.facts.size();
+            am.facts.push_back(fact);
+            for (int j : am.successors) {
+                if (!profiling) { rightActivate(j, fact, args); continue; }
+                auto t0 = chrono::steady_clock::now();
+                rightActivate(j, fact, args);
+                joins[j].seconds += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+            }
+        }
+    }
+
+    // A fact stopped being true: drop it and every token built on it
+    void removeFact(int fact, int pred, const vector<int> &args) {
+        if (pred >= (int)alphasByPred.size()) return;
+        for (int a : alphasByPred[pred]) {
+            AlphaMemory &am = alphas[a];
+            auto it = am.where.find(fact);
+            if (it == am.where.end()) continue;
+            int last = am.facts.back();
+            am.facts[it->second] = last;
+            am.where[last] = it->second;
+            am.facts.pop_back();
+            am.where.erase(fact);
+            for (int j : am.successors) {
+                auto b = joins[j].rightIndex.find(rightKey(joins[j], args));
+                if (b == joins[j].rightIndex.end()) continue;
+                eraseOne(b->second, fact);
+                if (b->second.empty()) joins[j].rightIndex.erase(b);
+            }
+        }
+        auto it = tokensByFact.find(fact);
+        if (it == tokensByFact.end()) return;
+        vector<int> doomed = move(it->second);
+        tokensByFact.erase(it);
+        for (int t : doomed) kill(t);
+    }
+
+    // Activations and time over the join nodes of a production; a shared
+    // node counts for every production using it
+    pair<uint64_t, double> productionCost(int prod) const {
+        pair<uint64_t, double> cost = {0, 0};
+        if (prod >= (int)productionNode.size()) return cost; // not compiled yet
+        for (int j = productionNode[prod]; j >= 0; j = joins[j].parent) {
+            cost.first += joins[j].activations;
+            cost.second += joins[j].seconds;
+        }
+        return cost;
+    }
+
+    void resetCounters() {
+        for (auto &j : joins) {
+            j.activations = 0;
+            j.seconds = 0;
+        }
+    }
+
+    size_t bytes() const;
+
+    static void eraseOne(vector<int> &v, int x) {
+        auto it = find(v.begin(), v.end(), x);
+        if (it == v.end()) return;
+        *it = v.back();
+        v.pop_back();
+    }
+
+    // Remove a token and its descendants from every index and free the slots
+    void kill(int t) {
+        if (tokens[t].dead) return;
+        tokens[t].dead = true;
+        vector<int> children = move(tokens[t].children);
+        for (int c : children) kill(c);
+
+        Token &tok = tokens[t];
+        JoinNode &node = joins[tok.node];
+        for (int c : node.children) {
+            auto b = joins[c].leftIndex.find(leftKey(joins[c], t));
+            if (b == joins[c].leftIndex.end()) continue;
+            eraseOne(b->second, t);
+            if (b->second.empty()) joins[c].leftIndex.erase(b);
+        }
+        int last = node.tokens.back();
+        node.tokens[tok.pos] = last;
+        tokens[last].pos = tok.pos;
+        node.tokens.pop_back();
+        if (tok.parent != 0 && !tokens[tok.parent].dead) eraseOne(tokens[tok.parent].children, t);
+        auto f = tokensByFact.find(tok.fact);
+        if (f != tokensByFact.end()) {
+            eraseOne(f->second, t);
+            if (f->second.empty()) tokensByFact.erase(f);
+        }
+        tok.slots.clear();
+        tok.children.clear();
+        freeTokens.push_back(t);
+    }
+
+    // Compile a rule body, sharing existing nodes; new nodes start filled
+    // from the facts already known. Returns the production id.
+    int addProduction(const vector<Pattern> &body) {
+        int parent = -1, slots = 0;
+        for (const Pattern &p : body) {
+            AlphaMemory am{p.pred, {}, {}, {}, {}, {}};
+            vector<pair<int, int>> tests, binds;
+            map<int, int> firstArg; // variable -> first argument using it in this pattern
+            for (int i = 0; i < (int)p.args.size(); i++) {
+                int arg = p.args[i];
+                if (arg >= 0) { am.constTests.push_back({i, arg}); continue; }
+                int v = -arg - 1;
+                if (firstArg.count(v)) { am.sameTests.push_back({i, firstArg[v]}); continue; }
+                firstArg[v] = i;
+                if (v < slots) tests.push_back({v, i});
+                else binds.push_back({i, v});
+            }
+
+            string akey = to_string(p.pred);
+            for (auto &[i, sym] : am.constTests) akey += " c" + to_string(i) + "=" + to_string(sym);
+            for (auto &[i, o] : am.sameTests) akey += " s" + to_string(i) + "=" + to_string(o);
+            int a;
+            auto ait = sharedAlpha.find(akey);
+            if (ait != sharedAlpha.end()) {
+                a = ait->second;
+            } else {
+                a = alphas.size();
+                for (int f : factsOf(p.pred)) {
+                    if (!alphaMatches(am, argsOf(f))) continue;
+                    am.where[f] = am.facts.size();
+                    am.facts.push_back(f);
+                }
+                alphas.push_back(move(am));
+                if (p.pred >= (int)alphasByPred.size()) alphasByPred.resize(p.pred + 1);
+                alphasByPred[p.pred].push_back(a);
+                sharedAlpha[akey] = a;
+            }
+
+            string jkey = to_string(parent) + "/" + to_string(a);
+            for (auto &[v, i] : tests) jkey += " t" + to_string(v) + "=" + to_string(i);
+            for (auto &[i, v] : binds) jkey += " b" + to_string(i) + "=" + to_string(v);
+            slots += binds.size();
+            auto jit = sharedJoin.find(jkey);
+            if (jit != sharedJoin.end()) { parent = jit->second; continue; }
+
+            int j = joins.size();
+            joins.push_back({parent, a, tests, binds, slots, {}, {}, {}, {}, {}});
+            alphas[a].successors.push_back(j);
+            if (parent >= 0) joins[parent].children.push_back(j);
+            sharedJoin[jkey] = j;
+            for (int f : alphas[a].facts)
+                joins[j].rightIndex[rightKey(joins[j], argsOf(f))].push_back(f);
+            if (parent < 0) {
+                leftActivate(j, 0);
+            } else {
+                vector<int> left = joins[parent].tokens;
+                for (int t : left)
+                    if (!tokens[t].dead) leftActivate(j, t);
+            }
+            parent = j;
+        }
+        int prod = productionNode.size();
+        productionNode.push_back(parent);
+        joins[parent].productions.push_back(prod);
+        for (int t : joins[parent].tokens)
+            if (!tokens[t].dead) matches.push_back({prod, t});
+        return prod;
+    }
+};
+
+size_t Rete::bytes() const {
+    size_t b = bytesOf(tokens) + bytesOf(alphas) + bytesOf(joins) + mapBytes(tokensByFact);
+    for (auto &t : tokens) b += bytesOf(t.slots) + bytesOf(t.children);
+    for (auto &a : alphas) b += bytesOf(a.facts) + mapBytes(a.where);
+    for (auto &j : joins) {
+        b += bytesOf(j.tokens) + mapBytes(j.leftIndex) + mapBytes(j.rightIndex);
+        for (auto &[key, v] : j.leftIndex) b += bytesOf(v);
+        for (auto &[key, v] : j.rightIndex) b += bytesOf(v);
+    }
+    for (auto &[fact, v] : tokensByFact) b += bytesOf(v);
+    return b;
+}
+
 struct Rule {
-    vector<string> antecedents;
-    string consequent;
+    vector<int> antecedents; // distinct symbol ids
+    int consequent;
+    int origin = -1;         // first-order rule it instantiates, -1 if written directly
+};
+
+struct FirstOrderRule {
+    vector<Pattern> body;
+    Pattern head;
+    string text;
+};
+
+// Counters kept per rule while inferring
+struct RuleStats {
+    uint64_t attempts = 0; // counter decrements
+    uint64_t firings = 0;
+    uint64_t derived = 0;  // firings that made a new fact
+    double seconds = 0;    // measured only while profiling
+};
+
+struct RunStats {
+    uint64_t runs = 0, rounds = 0, lastRounds = 0, propagated = 0, derived = 0;
+    double seconds = 0;
+};
+
+// One line of the stats report: a rule written by hand, or a first-order
+// rule together with all of its instances
+struct RuleReport {
+    string text;
+    uint64_t attempts, firings, derived;
+    double seconds;
+};
+
+static double secondsSince(chrono::steady_clock::time_point t0) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+struct VectorHash {
+    size_t operator()(const vector<int> &v) const {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (int x : v) h = Rete::mix(h, x);
+        return h;
+    }
+};
+
+struct KnowledgeBase {
+    // Symbol table. Every symbol is also an atom: a predicate (name/arity)
+    // applied to argument symbols; plain symbols have arity 0.
+    unordered_map<string_view, int> ids; // keys point into names
+    deque<string> names;                 // deque: growing never moves a name
+    vector<int> atomPred;
+    vector<vector<int>> atomArgs;
+    unordered_map<string, int> predIds;  // "name/arity" -> predicate id
+    string predKey, scratch;             // reused buffers for lookups
+    vector<string_view> viewArgs;
+    vector<string> predNames;
+    vector<vector<int>> atomsByPred;
+
+    vector<char> isFact;      // by symbol id
+    vector<char> asserted;    // given by the user (as opposed to only derived)
+    vector<char> propagated;  // fact already counted down in its watchers
+    vector<char> listed;      // appears in factList
+    vector<char> isDeleted;   // scratch mark for retract()
+    vector<int> factList;     // symbols in the order they first became true
+    size_t numFacts = 0;
+    vector<int> agenda;       // facts waiting to be propagated (FIFO from agendaHead)
+    size_t agendaHead = 0;
+
+    vector<Rule> rules;
+    vector<int> missing;            // per rule: antecedents not yet propagated
+    vector<vector<int>> watchers;   // per symbol: rules having it as antecedent
+    vector<vector<int>> supporters; // per symbol: rules concluding it
+    vector<int> ready;              // rules whose antecedents all hold, not yet fired
+
+    // First-order rules, indexed by their Rete production id
+    Rete rete;
+    vector<FirstOrderRule> firstOrder;
+    unordered_map<vector<int>, int, VectorHash> instances; // {production, head, premises...} -> rule
+
+    // Telemetry: see stats. Profiling adds clock reads to the inner loops.
+    vector<RuleStats> ruleStats; // per rule
+    RunStats runStats;
+    double fireSeconds = 0;      // time inside fire(), to keep it out of the counting share
+    bool quiet = false, profiling = false;
+
+    bool incremental = false;
+    size_t changes = 0;     // bumped on every change that can alter what holds
+    bool reteStale = false; // after loading a snapshot, until the network is rebuilt
+
+    KnowledgeBase() { wireRete(); }
+
+    // A copy gets its own symbol views and Rete callbacks
+    KnowledgeBase(const KnowledgeBase &other) {
+        *this = other;
+        ids.clear();
+        ids.reserve(names.size());
+        for (size_t i = 0; i < names.size(); i++) ids.emplace(names[i], i);
+        viewArgs.clear();
+        wireRete();
+    }
+
+private:
+    // Member-wise copy, still pointing into the source; only for the above
+    KnowledgeBase &operator=(const KnowledgeBase &) = default;
+
+public:
+
+    void wireRete() {
+        rete.argsOf = [this](int f) -> const vector<int> & { return atomArgs[f]; };
+        rete.factsOf = [this](int pred) {
+            vector<int> out;
+            for (int a : atomsByPred[pred])
+                if (isFact[a] && propagated[a]) out.push_back(a);
+            return out;
+        };
+        rete.profiling = profiling;
+    }
+
+    int predicate(string_view name, int arity) {
+        predKey.assign(name);
+        predKey += '/';
+        predKey += to_string(arity);
+        auto it = predIds.find(predKey);
+        if (it != predIds.end()) return it->second;
+        int id = predNames.size();
+        predIds.emplace(predKey, id);
+        predNames.emplace_back(name);
+        atomsByPred.emplace_back();
+        return id;
+    }
+
+    // `s` is a plain symbol or a canonical ground atom
+    int intern(const string &s) {
+        int id = lookup(s);
+        if (id >= 0) return id;
+        string_view name;
+        vector<string_view> argText;
+        if (!splitAtom(s, name, argText)) return addSymbol(s, predicate(s, 0), {});
+        vector<int> args;
+        for (string_view a : argText) args.push_back(internPlain(a));
+        int pred = predicate(name, args.size());
+        return addSymbol(s, pred, move(args));
+    }
+
+    // An argument: a symbol of arity 0
+    int internPlain(string_view a) {
+        int id = lookup(a);
+        return id >= 0 ? id : addSymbol(string(a), predicate(a, 0), {});
+    }
+
+    // Add a symbol known to be absent
+    int addSymbol(string s, int pred, vector<int> args) {
+        int id = names.size();
+        names.push_back(move(s));
+        ids.emplace(names.back(), id);
+        atomPred.push_back(pred);
+        atomArgs.push_back(move(args));
+        atomsByPred[pred].push_back(id);
+        isFact.push_back(0);
+        asserted.push_back(0);
+        propagated.push_back(0);
+        listed.push_back(0);
+        isDeleted.push_back(0);
+        watchers.emplace_back();
+        supporters.emplace_back();
+        return id;
+    }
+
+    int lookup(string_view s) const {
+        auto it = ids.find(s);
+        return it == ids.end() ? -1 : it->second;
+    }
+
+    // Intern a ground atom given as a view. It is split in place and its
+    // arguments are looked up as views; text is copied only into the names
+    // of new symbols (and a scratch buffer for non-canonical spacing).
+    // -1 if malformed.
+    int internView(string_view v) {
+        int id = lookup(v);
+        if (id >= 0) return id;
+        string_view name;
+        if (!splitAtom(v, name, viewArgs)) return -1;
+        size_t length = name.size() + (viewArgs.empty() ? 0 : viewArgs.size() + 1);
+        for (string_view a : viewArgs) {
+            if (a[0] == '?') return -1;
+            length += a.size();
+        }
+        string_view text = v;
+        if (length != v.size()) { // spaced differently: look up the canonical spelling
+            scratch.assign(name);
+            for (size_t i = 0; i < viewArgs.size(); i++) {
+                scratch += i ? ',' : '(';
+                scratch += viewArgs[i];
+            }
+            if (!viewArgs.empty()) scratch += ')';
+            id = lookup(scratch);
+            if (id >= 0) return id;
+            text = scratch;
+        }
+        vector<int> args;
+        for (string_view a : viewArgs) args.push_back(internPlain(a));
+        int pred = predicate(name, args.size());
+        return addSymbol(string(text), pred, move(args));
+    }
+
+    // Make a symbol true; it is propagated on the next run()
+    bool addFact(int id) {
+        if (isFact[id]) return false;
+        isFact[id] = 1;
+        numFacts++;
+        changes++;
+        if (!listed[id]) { listed[id] = 1; factList.push_back(id); }
+        agenda.push_back(id);
+        return true;
+    }
+
+    void assertFact(int id) {
+        asserted[id] = 1;
+        addFact(id);
+        if (incremental) run();
+    }
+
+    void addRule(const vector<int> &given, int consequent) {
+        insertRule(given, consequent, -1);
+        if (incremental) run();
+    }
+
+    void insertRule(const vector<int> &given, int consequent, int origin) {
+        vector<int> ants;
+        for (int a : given)
+            if (find(ants.begin(), ants.end(), a) == ants.end()) ants.push_back(a);
+        int r = rules.size();
+        int count = 0;
+        changes++;
+        for (int a : ants) {
+            watchers[a].push_back(r);
+            if (!propagated[a]) count++;
+        }
+        rules.push_back({move(ants), consequent, origin});
+        ruleStats.emplace_back();
+        supporters[consequent].push_back(r);
+        missing.push_back(count);
+        if (count == 0) ready.push_back(r);
+    }
+
+    // Compile a rule with variables into the Rete network. Variables are
+    // numbered by first use in the body; every head variable must occur there.
+    bool addFirstOrderRule(const vector<ParsedAtom> &body, const ParsedAtom &head, string &error) {
+        ensureRete();
+        map<string, int> slot;
+        auto toPattern = [&](const ParsedAtom &a, bool isHead, Pattern &p) {
+            p.pred = predicate(a.name, a.args.size());
+            p.args.clear();
+            for (auto &arg : a.args) {
+                if (!isVariable(arg)) { p.args.push_back(intern(arg)); continue; }
+                auto it = slot.find(arg);
+                if (it == slot.end()) {
+                    if (isHead) { error = "head variable " + arg + " does not occur in the body"; return false; }
+                    it = slot.emplace(arg, slot.size()).first;
+                }
+                p.args.push_back(-it->second - 1);
+            }
+            return true;
+        };
+        FirstOrderRule rule;
+        for (auto &a : body) {
+            rule.body.emplace_back();
+            toPattern(a, false, rule.body.back());
+        }
+        if (!toPattern(head, true, rule.head)) return false;
+        for (size_t i = 0; i < body.size(); i++) rule.text += (i ? " & " : "") + canonical(body[i]);
+        rule.text += " -> " + canonical(head);
+
+        rete.addProduction(rule.body);
+        firstOrder.push_back(move(rule));
+        changes++;
+        takeMatches();
+        if (incremental) run();
+        return true;
+    }
+
+    // Parse and add "A & B -> C"; error is left empty for malformed text
+    bool addRuleText(const string &text, string &error) {
+        string body = trim(text);
+        auto pos = body.find("->");
+        if (pos == string::npos) return false;
+        string lhs = trim(body.substr(0, pos));
+        string rhs = trim(body.substr(pos + 2));
+        ParsedAtom head;
+        vector<ParsedAtom> premises;
+        bool okAtoms = parseAtom(rhs, head), variables = okAtoms && hasVariables(head);
+        string token;
+        stringstream ss(lhs);
+        while (okAtoms && getline(ss, token, '&')) {
+            if (trim(token).empty()) continue;
+            premises.emplace_back();
+            okAtoms = parseAtom(token, premises.back());
+            variables = variables || (okAtoms && hasVariables(premises.back()));
+        }
+        if (!okAtoms) return false;
+        if (variables) return addFirstOrderRule(premises, head, error);
+        vector<int> ants;
+        for (auto &a : premises) ants.push_back(intern(canonical(a)));
+        addRule(ants, intern(canonical(head)));
+        return true;
+    }
+
+    // Key of a rule instance: {production, head, premises in first-use
+    // order}. Matches over the same facts in another order can bind
+    // different heads, so the head is part of the key.
+    static vector<int> instanceKey(int prod, int head, const vector<int> &premises) {
+        vector<int> key = {prod, head};
+        for (int p : premises)
+            if (find(key.begin() + 2, key.end(), p) == key.end()) key.push_back(p);
+        return key;
+    }
+
+    // Turn complete Rete matches into ground rule instances
+    void takeMatches() {
+        for (size_t i = 0; i < rete.matches.size(); i++) {
+            auto [prod, t] = rete.matches[i];
+            auto t0 = profileStart();
+            vector<int> premises;
+            for (int u = t; rete.tokens[u].fact >= 0; u = rete.tokens[u].parent)
+                premises.push_back(rete.tokens[u].fact);
+            reverse(premises.begin(), premises.end());
+
+            const Pattern &h = firstOrder[prod].head;
+            string text = predNames[h.pred];
+            for (size_t a = 0; a < h.args.size(); a++) {
+                int sym = h.args[a] >= 0 ? h.args[a] : rete.tokens[t].slots[-h.args[a] - 1];
+                text += (a ? "," : "(") + names[sym];
+            }
+            if (!h.args.empty()) text += ")";
+            int head = intern(text);
+
+            vector<int> key = instanceKey(prod, head, premises);
+            if (!instances.emplace(key, rules.size()).second) continue;
+            insertRule(vector<int>(key.begin() + 2, key.end()), head, prod);
+            if (profiling) ruleStats.back().seconds += secondsSince(t0);
+        }
+        rete.matches.clear();
+    }
+
+    string ruleText(int r) const {
+        string text;
+        for (size_t i = 0; i < rules[r].antecedents.size(); i++)
+            text += (i ? " & " : "") + names[rules[r].antecedents[i]];
+        return text + " -> " + names[rules[r].consequent];
+    }
+
+    void fire(int r) {
+        auto t0 = profileStart();
+        int c = rules[r].consequent;
+        ruleStats[r].firings++;
+        if (addFact(c)) {
+            ruleStats[r].derived++;
+            runStats.derived++;
+            if (!quiet) cout << "Derived: " << names[c] << "\n";
+        }
+        if (profiling) {
+            double spent = secondsSince(t0);
+            ruleStats[r].seconds += spent;
+            fireSeconds += spent;
+        }
+    }
+
+    // A loaded snapshot carries the derived closure but not the network's
+    // memories; they are rebuilt from the current facts the first time a
+    // change needs them. Every match found then already has its instance.
+    void ensureRete() {
+        if (!reteStale) return;
+        reteStale = false;
+        rete = Rete();
+        wireRete();
+        for (auto &r : firstOrder) rete.addProduction(r.body);
+        takeMatches();
+    }
+
+    // Propagate until no rule can fire. A round is one generation of the
+    // FIFO agenda: the facts queued before the previous round finished.
+    void run() {
+        if (agendaHead < agenda.size()) ensureRete();
+        auto start = chrono::steady_clock::now();
+        uint64_t rounds = 0;
+        while (!ready.empty() || agendaHead < agenda.size()) {
+            for (size_t i = 0; i < ready.size(); i++)
+                if (missing[ready[i]] == 0) fire(ready[i]);
+            ready.clear();
+            size_t roundEnd = agendaHead;
+            while (agendaHead < agenda.size()) {
+                if (agendaHead == roundEnd) {
+                    rounds++;
+                    roundEnd = agenda.size();
+                }
+                int p = agenda[agendaHead++];
+                if (!isFact[p] || propagated[p]) continue; // retracted or queued twice
+                propagated[p] = 1;
+                runStats.propagated++;
+                auto t0 = profileStart();
+                double fired = fireSeconds;
+                for (int r : watchers[p]) {
+                    ruleStats[r].attempts++;
+                    if (--missing[r] == 0) fire(r);
+                }
+                if (profiling && !watchers[p].empty()) {
+                    // Every decrement costs the same, so the counting time
+                    // is shared evenly; firing was charged in fire()
+                    double share = (secondsSince(t0) - (fireSeconds - fired)) / watchers[p].size();
+                    for (int r : watchers[p]) ruleStats[r].seconds += share;
+                }
+                rete.addFact(p, atomPred[p], atomArgs[p]);
+                takeMatches();
+            }
+        }
+        agenda.clear();
+        agendaHead = 0;
+        runStats.runs++;
+        runStats.rounds += rounds;
+        runStats.lastRounds = rounds;
+        runStats.seconds += secondsSince(start);
+    }
+
+    // ----- Telemetry -----
+    // Clock reads cost more than a counter update, so skip them unless profiling
+    chrono::steady_clock::time_point profileStart() const {
+        return profiling ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+    }
+
+    void setProfiling(bool on) {
+        profiling = on;
+        rete.profiling = on;
+    }
+
+    void resetStats() {
+        ruleStats.assign(rules.size(), RuleStats());
+        runStats = RunStats();
+        fireSeconds = 0;
+        rete.resetCounters();
+    }
+
+    // Per-rule totals; instances are added to their first-order rule, whose
+    // attempts also include the Rete join activations along its body
+    vector<RuleReport> ruleReport() const {
+        vector<RuleReport> out;
+        for (size_t k = 0; k < firstOrder.size(); k++) {
+            auto [activations, seconds] = rete.productionCost(k);
+            out.push_back({firstOrder[k].text, activations, 0, 0, seconds});
+        }
+        for (size_t r = 0; r < rules.size(); r++) {
+            const RuleStats &st = ruleStats[r];
+            if (rules[r].origin < 0) {
+                out.push_back({ruleText(r), st.attempts, st.firings, st.derived, st.seconds});
+                continue;
+            }
+            RuleReport &row = out[rules[r].origin];
+            row.attempts += st.attempts;
+            row.firings += st.firings;
+            row.derived += st.derived;
+            row.seconds += st.seconds;
+        }
+        return out;
+    }
+
+    size_t factStoreBytes() const {
+        size_t b = mapBytes(ids) + mapBytes(predIds) + bytesOf(atomPred) + bytesOf(atomArgs) +
+                   bytesOf(atomsByPred) + bytesOf(isFact) + bytesOf(asserted) + bytesOf(propagated) +
+                   bytesOf(listed) + bytesOf(isDeleted) + bytesOf(factList) + bytesOf(agenda);
+        for (auto &n : names) b += sizeof(string) + (n.capacity() > 15 ? n.capacity() + 1 : 0);
+        return b;
+    }
+
+    size_t ruleStoreBytes() const {
+        size_t b = bytesOf(rules) + bytesOf(missing) + bytesOf(watchers) + bytesOf(supporters) +
+                   bytesOf(ready) + bytesOf(ruleStats) + mapBytes(instances) + rete.bytes();
+        for (auto &r : rules) b += bytesOf(r.antecedents);
+        for (auto &[key, r] : instances) b += bytesOf(key);
+        for (auto &r : firstOrder) b += sizeof(r) + r.text.capacity() + bytesOf(r.body) + bytesOf(r.head.args);
+        return b;
+    }
+
+    // ----- Bulk loading -----
+    struct LoadStats {
+        size_t lines = 0, facts = 0, rules = 0, bad = 0;
+    };
+
+    // Ground rules are split and interned straight from the mapped text;
+    // rules with variables go through the regular parser.
+    bool addRuleView(string_view body) {
+        if (body.find('?') != string_view::npos) {
+            string error;
+            return addRuleText(string(body), error);
+        }
+        size_t arrow = body.find("->");
+        if (arrow == string_view::npos) return false;
+        int head = internView(trimView(body.substr(arrow + 2)));
+        if (head < 0) return false;
+        vector<int> ants;
+        string_view lhs = body.substr(0, arrow);
+        while (true) {
+            size_t amp = lhs.find('&');
+            string_view tok = trimView(lhs.substr(0, amp));
+            if (!tok.empty()) {
+                int id = internView(tok);
+                if (id < 0) return false;
+                ants.push_back(id);
+            }
+            if (amp == string_view::npos) break;
+            lhs.remove_prefix(amp + 1);
+        }
+        insertRule(ants, head, -1);
+        return true;
+    }
+
+    // Load "fact ..." and "rule ..." lines ('#' starts a comment line).
+    // Nothing is propagated until the next run, or once at the end in
+    // incremental mode.
+    bool loadText(const string &path, LoadStats &st) {
+        MappedFile file;
+        if (!file.open(path)) return false;
+        string_view text = file.view();
+        // Most lines bring new symbols; size the tables once instead of
+        // rehashing them over and over
+        size_t lines = count(text.begin(), text.end(), '\n') + 1;
+        ids.reserve(ids.size() + 2 * lines);
+        predIds.reserve(predIds.size() + lines);
+        bool wasIncremental = incremental;
+        incremental = false;
+        for (size_t pos = 0; pos < text.size();) {
+            size_t end = text.find('\n', pos);
+            if (end == string_view::npos) end = text.size();
+            string_view line = trimView(text.substr(pos, end - pos));
+            pos = end + 1;
+            st.lines++;
+            if (line.empty() || line[0] == '#') continue;
+            if (line.substr(0, 5) == "fact ") {
+                int id = internView(trimView(line.substr(5)));
+                if (id < 0) { st.bad++; continue; }
+                asserted[id] = 1;
+                addFact(id);
+                st.facts++;
+            } else if (line.substr(0, 5) == "rule ") {
+                if (addRuleView(line.substr(5))) st.rules++;
+                else st.bad++;
+            } else {
+                st.bad++;
+            }
+        }
+        incremental = wasIncremental;
+        if (incremental) run();
+        return true;
+    }
+
+    // ----- Snapshots -----
+    bool saveSnapshot(const string &path) {
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        SnapshotWriter w{f};
+        w.raw(SNAPSHOT_MAGIC, 4);
+        w.u64(SNAPSHOT_VERSION);
+
+        vector<string> predKeys(predNames.size());
+        for (auto &[key, id] : predIds) predKeys[id] = key;
+        w.strings(names);
+        w.array(atomPred);
+        w.nested(atomArgs);
+        w.strings(predKeys);
+        w.strings(predNames);
+        w.nested(atomsByPred);
+
+        w.array(isFact);
+        w.array(asserted);
+        w.array(propagated);
+        w.array(listed);
+        w.array(factList);
+        w.u64(numFacts);
+        w.array(vector<int>(agenda.begin() + agendaHead, agenda.end()));
+
+        vector<vector<int>> ants;
+        vector<int> consequents, origins;
+        for (auto &r : rules) {
+            ants.push_back(r.antecedents);
+            consequents.push_back(r.consequent);
+            origins.push_back(r.origin);
+        }
+        w.nested(ants);
+        w.array(consequents);
+        w.array(origins);
+        w.array(missing);
+        w.nested(watchers);
+        w.nested(supporters);
+        w.array(ready);
+
+        // First-order rules: patterns flattened as pred, arity, args...
+        vector<vector<int>> patterns;
+        vector<string> texts;
+        for (auto &r : firstOrder) {
+            vector<int> flat = {(int)r.body.size()};
+            for (size_t i = 0; i <= r.body.size(); i++) {
+                const Pattern &p = i < r.body.size() ? r.body[i] : r.head;
+                flat.push_back(p.pred);
+                flat.push_back(p.args.size());
+                flat.insert(flat.end(), p.args.begin(), p.args.end());
+            }
+            patterns.push_back(move(flat));
+            texts.push_back(r.text);
+        }
+        w.nested(patterns);
+        w.strings(texts);
+
+        bool ok = w.ok;
+        return fclose(f) == 0 && ok;
+    }
+
+    // Replace the whole knowledge base with a snapshot. Nothing is parsed
+    // and nothing is re-inferred; only the hash maps are rebuilt.
+    bool loadSnapshot(const string &path) {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        SnapshotReader r{f, uint64_t(max(size, 0L))};
+        char magic[4] = {};
+        r.raw(magic, 4);
+        if (!r.ok || memcmp(magic, SNAPSHOT_MAGIC, 4) != 0 || r.u64() != SNAPSHOT_VERSION) {
+            fclose(f);
+            return false;
+        }
+
+        deque<string> nNames;
+        vector<int> nAtomPred, nFactList, nAgenda, nConsequents, nOrigins, nMissing, nReady;
+        vector<vector<int>> nAtomArgs, nAtomsByPred, nAnts, nWatchers, nSupporters, nPatterns;
+        vector<string> predKeys, nPredNames, texts;
+        vector<char> nIsFact, nAsserted, nPropagated, nListed;
+        r.strings(nNames);
+        r.array(nAtomPred);
+        r.nested(nAtomArgs);
+        r.strings(predKeys);
+        r.strings(nPredNames);
+        r.nested(nAtomsByPred);
+        r.array(nIsFact);
+        r.array(nAsserted);
+        r.array(nPropagated);
+        r.array(nListed);
+        r.array(nFactList);
+        uint64_t nNumFacts = r.u64();
+        r.array(nAgenda);
+        r.nested(nAnts);
+        r.array(nConsequents);
+        r.array(nOrigins);
+        r.array(nMissing);
+        r.nested(nWatchers);
+        r.nested(nSupporters);
+        r.array(nReady);
+        r.nested(nPatterns);
+        r.strings(texts);
+        fclose(f);
+
+        size_t n = nNames.size();
+        if (!r.ok || nAtomPred.size() != n || nAtomArgs.size() != n || nIsFact.size() != n ||
+            nAsserted.size() != n || nPropagated.size() != n || nListed.size() != n ||
+            nWatchers.size() != n || nSupporters.size() != n || predKeys.size() != nPredNames.size() ||
+            nAtomsByPred.size() != nPredNames.size() || nConsequents.size() != nAnts.size() ||
+            nOrigins.size() != nAnts.size() || nMissing.size() != nAnts.size() || texts.size() != nPatterns.size())
+            return false;
+
+        vector<FirstOrderRule> nFirstOrder;
+        for (size_t i = 0; i < nPatterns.size(); i++) {
+            const vector<int> &flat = nPatterns[i];
+            FirstOrderRule rule;
+            size_t at = 1;
+            if (flat.empty() || flat[0] < 1) return false;
+            for (int k = 0; k <= flat[0]; k++) {
+                if (at + 2 > flat.size() || flat[at + 1] < 0 || at + 2 + flat[at + 1] > flat.size()) return false;
+                Pattern p{flat[at], vector<int>(flat.begin() + at + 2, flat.begin() + at + 2 + flat[at + 1])};
+                at += 2 + flat[at + 1];
+                (k < flat[0] ? rule.body.push_back(p) : void(rule.head = p));
+            }
+            if (at != flat.size()) return false;
+            rule.text = texts[i];
+            nFirstOrder.push_back(move(rule));
+        }
+
+        // Every stored id must be in range before anything is replaced
+        size_t numRules = nAnts.size(), numPreds = predKeys.size();
+        auto inRange = [](const vector<int> &v, size_t limit) {
+            return all_of(v.begin(), v.end(), [&](int x) { return x >= 0 && size_t(x) < limit; });
+        };
+        auto allInRange = [&](const vector<vector<int>> &v, size_t limit) {
+            return all_of(v.begin(), v.end(), [&](const vector<int> &inner) { return inRange(inner, limit); });
+        };
+        vector<size_t> arity(numPreds);
+        for (size_t p = 0; p < numPreds; p++) {
+            size_t slash = predKeys[p].rfind('/');
+            if (slash == string::npos) return false;
+            arity[p] = strtoul(predKeys[p].c_str() + slash + 1, nullptr, 10);
+        }
+        bool valid = inRange(nAtomPred, numPreds) && allInRange(nAtomArgs, n) && allInRange(nAtomsByPred, n) &&
+                     inRange(nFactList, n) && inRange(nAgenda, n) && allInRange(nAnts, n) &&
+                     inRange(nConsequents, n) && allInRange(nWatchers, numRules) &&
+                     allInRange(nSupporters, numRules) && inRange(nReady, numRules) &&
+                     nNumFacts == size_t(count_if(nIsFact.begin(), nIsFact.end(), [](char c) { return c != 0; }));
+        for (size_t i = 0; valid && i < n; i++) valid = nAtomArgs[i].size() == arity[nAtomPred[i]];
+        for (size_t p = 0; valid && p < numPreds; p++)
+            for (int a : nAtomsByPred[p]) valid = valid && nAtomPred[a] == (int)p;
+        for (size_t i = 0; valid && i < numRules; i++)
+            valid = nOrigins[i] >= -1 && nOrigins[i] < (int)nFirstOrder.size() && nMissing[i] >= 0 &&
+                    nMissing[i] <= (int)nAnts[i].size();
+        // Patterns: known predicate and arity, constants in range, and
+        // variables numbered by first use in the body as the compiler does
+        for (size_t i = 0; valid && i < nFirstOrder.size(); i++) {
+            const FirstOrderRule &rule = nFirstOrder[i];
+            int slots = 0;
+            for (size_t k = 0; valid && k <= rule.body.size(); k++) {
+                const Pattern &p = k < rule.body.size() ? rule.body[k] : rule.head;
+                valid = p.pred >= 0 && size_t(p.pred) < numPreds && p.args.size() == arity[p.pred];
+                for (size_t m = 0; valid && m < p.args.size(); m++) {
+                    int x = p.args[m];
+                    if (x >= 0) valid = size_t(x) < n;
+                    else if (-(x + 1) == slots && k < rule.body.size()) slots++;
+                    else valid = -(x + 1) < slots;
+                }
+            }
+        }
+        // The id map doubles as the duplicate-name check
+        decltype(ids) nIds;
+        nIds.reserve(n);
+        for (size_t i = 0; valid && i < n; i++) valid = nIds.emplace(nNames[i], i).second;
+        if (!valid) return false;
+
+        names = move(nNames); // moving the deque keeps the views in nIds valid
+        ids = move(nIds);
+        atomPred = move(nAtomPred);
+        atomArgs = move(nAtomArgs);
+        predIds.clear();
+        for (size_t i = 0; i < predKeys.size(); i++) predIds.emplace(predKeys[i], i);
+        predNames = move(nPredNames);
+        atomsByPred = move(nAtomsByPred);
+
+        isFact = move(nIsFact);
+        asserted = move(nAsserted);
+        propagated = move(nPropagated);
+        listed = move(nListed);
+        isDeleted.assign(n, 0);
+        factList = move(nFactList);
+        numFacts = nNumFacts;
+        agenda = move(nAgenda);
+        agendaHead = 0;
+
+        rules.clear();
+        instances.clear();
+        for (size_t i = 0; i < nAnts.size(); i++) {
+            rules.push_back({move(nAnts[i]), nConsequents[i], nOrigins[i]});
+            if (nOrigins[i] < 0) continue;
+            instances.emplace(instanceKey(nOrigins[i], nConsequents[i], rules.back().antecedents), i);
+        }
+        missing = move(nMissing);
+        ruleStats.assign(rules.size(), RuleStats());
+        watchers = move(nWatchers);
+        supporters = move(nSupporters);
+        ready = move(nReady);
+
+        firstOrder = move(nFirstOrder);
+        changes++;
+        rete = Rete();
+        wireRete();
+        reteStale = !firstOrder.empty();
+        return true;
+    }
+
+    // Retract an asserted fact; `removed` receives every fact that no longer
+    // holds. Returns false if the symbol was not asserted.
+    bool retract(int x, vector<int> &removed) {
+        if (!asserted[x]) return false;
+        asserted[x] = 0;
+        changes++;
+        if (!propagated[x]) {
+            // Still waiting on the agenda, so nothing was derived from it yet
+            for (int r : supporters[x])
+                if (missing[r] == 0) return true; // also derived: still holds
+            isFact[x] = 0;
+            numFacts--;
+            removed.push_back(x);
+            return true;
+        }
+
+        // Delete: x and, transitively, every fact derived by a rule that was
+        // satisfied through a deleted fact (asserted facts are kept)
+        vector<int> deleted = {x};
+        isDeleted[x] = 1;
+        isFact[x] = 0;
+        for (size_t i = 0; i < deleted.size(); i++) {
+            int p = deleted[i];
+            propagated[p] = 0;
+            for (int r : watchers[p]) {
+                if (missing[r]++ != 0) continue;
+                int c = rules[r].consequent;
+                if (isFact[c] && !asserted[c] && propagated[c]) {
+                    isFact[c] = 0;
+                    isDeleted[c] = 1;
+                    deleted.push_back(c);
+                }
+            }
+        }
+
+        // Rederive: a deleted fact with a fully satisfied rule comes back,
+        // and propagating it may bring back others that depended on it
+        vector<int> restore;
+        for (int d : deleted) {
+            for (int r : supporters[d]) {
+                if (missing[r] == 0) {
+                    isFact[d] = 1;
+                    restore.push_back(d);
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < restore.size(); i++) {
+            int p = restore[i];
+            propagated[p] = 1;
+            for (int r : watchers[p]) {
+                if (--missing[r] != 0) continue;
+                int c = rules[r].consequent;
+                if (isDeleted[c] && !isFact[c]) {
+                    isFact[c] = 1;
+                    restore.push_back(c);
+                }
+            }
+        }
+
+        for (int d : deleted) {
+            isDeleted[d] = 0;
+            if (!isFact[d]) {
+                numFacts--;
+                removed.push_back(d);
+                rete.removeFact(d, atomPred[d], atomArgs[d]);
+            }
+        }
+        return true;
+    }
 };
 
-int main() {
+// ---------- Backward chaining ----------
+// Proves one goal on demand instead of computing the whole closure. A call
+// is a predicate with some arguments bound (-1 where free) and is tabled
+// with every answer (ground atom id) found for it, so shared and repeated
+// subgoals are solved once. A call reached again while it is still being
+// evaluated gets the answers found so far; the outermost call of such a
+// recursive group re-evaluates it until no new answer appears and then
+// marks the whole group complete. A complete call without answers is a
+// tabled failure. Tables live until the knowledge base changes.
+//
+// The search is recursive. Frame sizes differ a lot between -g and -O2
+// builds, so instead of a depth limit each call measures the stack used so
+// far; past PROOF_STACK_BYTES (half of the 1 MB Windows default) the query
+// is answered from the forward closure instead.
+const size_t PROOF_STACK_BYTES = 512 * 1024;
+
+struct BackwardChainer {
+    struct Call {
+        const vector<int> *key = nullptr; // its key in callIds
+        vector<int> answers;
+        unordered_set<int> seen;
+        bool complete = false;
+        int depth = -1; // position on the stack while being evaluated
+        int low = -1;   // once left unfinished: depth of the call its group waits on
+    };
+
+    // Why an atom holds: a fact, a ground rule or a first-order rule,
+    // with the premises that were used
+    struct Reason {
+        int rule = -1;
+        int firstOrder = -1;
+        vector<int> premises;
+    };
+
+    KnowledgeBase &kb;
+    size_t version = 0; // kb.changes the tables belong to
+    unordered_map<vector<int>, int, VectorHash> callIds;
+    vector<Call> calls;
+    unordered_map<int, Reason> reasons;
+    vector<int> pending; // unfinished calls, re-evaluated by the leader of their group
+    int stackDepth = 0;
+    size_t added = 0;    // answers found so far
+    bool explaining = false; // derived facts are proved again, for proof trees
+    uintptr_t stackBase = 0;  // address of a local in ask()
+
+    struct TooDeep {};
+
+    explicit BackwardChainer(KnowledgeBase &kb) : kb(kb) {}
+
+    void sync() {
+        if (version != kb.changes) clear();
+    }
+
+    void clear() {
+        version = kb.changes;
+        explaining = false;
+        callIds.clear();
+        calls.clear();
+        reasons.clear();
+    }
+
+    // Atom with the given predicate and ground arguments, -1 if not interned
+    int atomOf(int pred, const vector<int> &args, bool create) {
+        string text = kb.predNames[pred];
+        for (size_t i = 0; i < args.size(); i++) text += (i ? "," : "(") + kb.names[args[i]];
+        if (!args.empty()) text += ")";
+        int id = kb.lookup(text);
+        return id < 0 && create ? kb.intern(text) : id;
+    }
+
+    bool fits(const vector<int> &key, int a) const {
+        if (kb.atomPred[a] != key[0]) return false;
+        for (size_t i = 1; i < key.size(); i++)
+            if (key[i] >= 0 && kb.atomArgs[a][i - 1] != key[i]) return false;
+        return true;
+    }
+
+    void answer(int c, int a, Reason why) {
+        if (!calls[c].seen.insert(a).second) return;
+        calls[c].answers.push_back(a);
+        reasons.emplace(a, move(why));
+        added++;
+    }
+
+    // Evaluate a call; `low` is lowered to the depth of any unfinished call
+    // it depended on. Calls that depend on each other form a group, led by
+    // the one lowest on the stack: the leader evaluates the whole group
+    // again until no answer is added, then completes it. Members reached in
+    // the meantime only hand out their answers so far.
+    int solve(const vector<int> &key, int &low) {
+        auto [it, fresh] = callIds.emplace(key, calls.size());
+        int c = it->second;
+        if (fresh) {
+            calls.emplace_back();
+            calls[c].key = &it->first;
+        }
+        if (calls[c].complete) return c;
+        if (calls[c].depth >= 0 || calls[c].low >= 0) {
+            low = min(low, calls[c].depth >= 0 ? calls[c].depth : calls[c].low);
+            return c;
+        }
+        char here;
+        uintptr_t at = reinterpret_cast<uintptr_t>(&here);
+        if ((at < stackBase ? stackBase - at : at - stackBase) > PROOF_STACK_BYTES) throw TooDeep();
+        int depth = stackDepth++;
+        calls[c].depth = depth;
+        size_t mark = pending.size();
+        int deepest = INT_MAX;
+        size_t before = added;
+        expand(c, key, deepest);
+        while (deepest == depth && added != before) {
+            before = added;
+            expand(c, key, deepest);
+            for (size_t i = mark; i < pending.size(); i++) expand(pending[i], *calls[pending[i]].key, deepest);
+        }
+        calls[c].depth = -1;
+        stackDepth--;
+        if (deepest < depth) {
+            // Part of a group led further down; its members now wait on that
+            for (size_t i = mark; i < pending.size(); i++) calls[pending[i]].low = deepest;
+            calls[c].low = deepest;
+            pending.push_back(c);
+            low = min(low, deepest);
+        } else {
+            calls[c].complete = true;
+            for (size_t i = mark; i < pending.size(); i++) {
+                calls[pending[i]].complete = true;
+                calls[pending[i]].low = -1;
+            }
+            pending.resize(mark);
+        }
+        return c;
+    }
+
+    bool holds(int a, int &low) {
+        vector<int> key = {kb.atomPred[a]};
+        key.insert(key.end(), kb.atomArgs[a].begin(), kb.atomArgs[a].end());
+        return !calls[solve(key, low)].answers.empty();
+    }
+
+    void expand(int c, const vector<int> &key, int &low) {
+        // Known atoms: facts, and conclusions of ground rules
+        auto known = [&](int a) {
+            if (kb.isFact[a] && (kb.asserted[a] || !explaining)) {
+                answer(c, a, {});
+                return;
+            }
+            for (size_t i = 0; i < kb.supporters[a].size(); i++) {
+                int r = kb.supporters[a][i];
+                if (kb.rules[r].origin >= 0) continue; // covered by its first-order rule
+                bool all = true;
+                for (int p : kb.rules[r].antecedents)
+                    if (!holds(p, low)) { all = false; break; }
+                if (all) {
+                    answer(c, a, {r, -1, kb.rules[r].antecedents});
+                    return;
+                }
+            }
+        };
+        if (find(key.begin() + 1, key.end(), -1) == key.end()) {
+            int a = atomOf(key[0], vector<int>(key.begin() + 1, key.end()), false);
+            if (a >= 0) known(a);
+        } else {
+            for (size_t i = 0; i < kb.atomsByPred[key[0]].size(); i++) {
+                int a = kb.atomsByPred[key[0]][i];
+                if (fits(key, a)) known(a);
+            }
+        }
+
+        for (size_t k = 0; k < kb.firstOrder.size(); k++) {
+            const FirstOrderRule &rule = kb.firstOrder[k];
+            if (rule.head.pred != key[0]) continue;
+            int numSlots = 0;
+            for (auto &p : rule.body)
+                for (int x : p.args) numSlots = max(numSlots, -x);
+            vector<int> slots(numSlots, -1), premises;
+            bool unifies = true;
+            for (size_t i = 0; i < rule.head.args.size() && unifies; i++) {
+                int h = rule.head.args[i], g = key[i + 1];
+                if (g < 0) continue;
+                if (h >= 0) unifies = h == g;
+                else if (slots[-h - 1] < 0) slots[-h - 1] = g;
+                else unifies = slots[-h - 1] == g;
+            }
+            if (unifies) matchBody(c, key, k, 0, slots, premises, low);
+        }
+    }
+
+    // Solve the body of first-order rule k left to right, each premise as a
+    // call with the variables bound so far
+    void matchBody(int c, const vector<int> &key, int k, size_t i, vector<int> &slots,
+                   vector<int> &premises, int &low) {
+        const FirstOrderRule &rule = kb.firstOrder[k];
+        if (i == rule.body.size()) {
+            vector<int> args;
+            for (int x : rule.head.args) args.push_back(x >= 0 ? x : slots[-x - 1]);
+            int a = atomOf(rule.head.pred, args, true);
+            if (fits(key, a)) answer(c, a, {-1, k, premises});
+            return;
+        }
+        const Pattern &p = rule.body[i];
+        vector<int> sub = {p.pred};
+        for (int x : p.args) sub.push_back(x >= 0 ? x : slots[-x - 1]);
+        int s = solve(sub, low);
+        for (size_t j = 0; j < calls[s].answers.size(); j++) {
+            int a = calls[s].answers[j];
+            vector<int> saved = slots;
+            bool consistent = true;
+            for (size_t m = 0; m < p.args.size() && consistent; m++) {
+                if (p.args[m] >= 0) continue;
+                int &v = slots[-p.args[m] - 1], val = kb.atomArgs[a][m];
+                if (v < 0) v = val;
+                else consistent = v == val;
+            }
+            if (consistent) {
+                premises.push_back(a);
+                matchBody(c, key, k, i + 1, slots, premises, low);
+                premises.pop_back();
+            }
+            slots = saved;
+        }
+    }
+
+    // All atoms matching `query`; free arguments are "?..." variables, and
+    // a variable used twice must take the same value. A plain ask takes
+    // facts already derived by run() as given; `explain` proves them again
+    // so that every answer has a full proof tree.
+    vector<int> ask(const ParsedAtom &query, bool explain = false) {
+        sync();
+        if (explain && !explaining) clear();
+        if (explain) explaining = true;
+        vector<int> key = {kb.predicate(query.name, query.args.size())};
+        for (auto &arg : query.args) key.push_back(isVariable(arg) ? -1 : kb.intern(arg));
+        vector<int> found;
+        char base;
+        stackBase = reinterpret_cast<uintptr_t>(&base);
+        try {
+            int low = INT_MAX;
+            found = calls[solve(key, low)].answers;
+        } catch (TooDeep &) {
+            // Half-evaluated tables are useless. Answer from the closure of a
+            // copy: asking must not run inference on the knowledge base.
+            stackDepth = 0;
+            pending.clear();
+            clear();
+            KnowledgeBase closure = kb;
+            closure.quiet = true;
+            closure.run();
+            for (int a : closure.atomsByPred[key[0]]) {
+                bool match = closure.isFact[a];
+                for (size_t i = 1; match && i < key.size(); i++)
+                    match = key[i] < 0 || closure.atomArgs[a][i - 1] == key[i];
+                if (!match) continue;
+                int b = size_t(a) < kb.names.size() ? a : kb.intern(closure.names[a]);
+                found.push_back(b);
+                reasons.emplace(b, Reason());
+            }
+        }
+        vector<int> out;
+        for (int a : found) {
+            bool same = true;
+            for (size_t i = 0; i < query.args.size(); i++)
+                for (size_t j = 0; j < i; j++)
+                    if (isVariable(query.args[i]) && query.args[i] == query.args[j] &&
+                        kb.atomArgs[a][i] != kb.atomArgs[a][j])
+                        same = false;
+            if (same) out.push_back(a);
+        }
+        return out;
+    }
+
+    // Indented proof of an answer; subproofs already printed are referenced
+    void printProof(int a, int indent, unordered_set<int> &shown, ostream &out) const {
+        const Reason &why = reasons.at(a);
+        out << string(indent * 2, ' ') << kb.names[a];
+        if (why.rule < 0 && why.firstOrder < 0) {
+            out << "  [" << (kb.asserted[a] ? "fact" : "entailed; too deep to prove backwards") << "]\n";
+            return;
+        }
+        if (!shown.insert(a).second) {
+            out << "  (see above)\n";
+            return;
+        }
+        out << "  [rule " << (why.rule >= 0 ? kb.ruleText(why.rule) : kb.firstOrder[why.firstOrder].text) << "]\n";
+        for (int p : why.premises) printProof(p, indent + 1, shown, out);
+    }
+};
+
+// ---------- Stats report ----------
+static string jsonString(const string &text) {
+    string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static string megabytes(size_t bytes) {
+    ostringstream out;
+    out << fixed << setprecision(2) << bytes / 1048576.0 << " MB";
+    return out.str();
+}
+
+// Rules that did any work, costliest first: by time when profiled, else by attempts
+static vector<RuleReport> hottestRules(const KnowledgeBase &kb) {
+    vector<RuleReport> rows;
+    for (auto &row : kb.ruleReport())
+        if (row.attempts || row.firings) rows.push_back(row);
+    stable_sort(rows.begin(), rows.end(), [&](const RuleReport &a, const RuleReport &b) {
+        if (kb.profiling && a.seconds != b.seconds) return a.seconds > b.seconds;
+        return a.attempts > b.attempts;
+    });
+    return rows;
+}
+
+// Rules as written, and the ground instances made from first-order rules
+static pair<size_t, size_t> ruleCounts(const KnowledgeBase &kb) {
+    size_t instances = count_if(kb.rules.begin(), kb.rules.end(), [](const Rule &r) { return r.origin >= 0; });
+    return {kb.rules.size() - instances + kb.firstOrder.size(), instances};
+}
+
+void printStats(const KnowledgeBase &kb, ostream &out) {
+    const RunStats &rs = kb.runStats;
+    auto [written, instances] = ruleCounts(kb);
+    double ms = rs.seconds * 1000;
+    out << "Runs: " << rs.runs << ", rounds to fixpoint: " << rs.lastRounds << " (last run), " << rs.rounds
+        << " in total\n"
+        << "Facts: " << kb.numFacts << " true, " << rs.derived << " derived, " << rs.propagated
+        << " propagated in " << fixed << setprecision(1) << ms << " ms (" << setprecision(0)
+        << (rs.seconds > 0 ? rs.propagated / rs.seconds : 0) << " facts/sec)\n"
+        << "Memory: fact store " << megabytes(kb.factStoreBytes()) << ", rule store "
+        << megabytes(kb.ruleStoreBytes()) << "\n"
+        << "Rules: " << written << " (" << kb.firstOrder.size() << " first-order), " << instances
+        << " first-order instances"
+        << (kb.profiling ? "" : "; 'profile on' to time them") << "\n";
+    vector<RuleReport> rows = hottestRules(kb);
+    if (rows.empty()) return;
+    out << "Hottest rules:\n"
+        << "    attempts    firings    derived        ms  rule\n";
+    for (size_t i = 0; i < rows.size() && i < 10; i++)
+        out << setw(12) << rows[i].attempts << setw(11) << rows[i].firings << setw(11) << rows[i].derived
+            << setw(10) << setprecision(2) << rows[i].seconds * 1000 << "  " << rows[i].text << "\n";
+}
+
+void printStatsJson(const KnowledgeBase &kb, ostream &out) {
+    const RunStats &rs = kb.runStats;
+    auto [written, instances] = ruleCounts(kb);
+    out << "{\"runs\":" << rs.runs << ",\"rounds\":" << rs.rounds << ",\"last_rounds\":" << rs.lastRounds
+        << ",\"facts\":" << kb.numFacts << ",\"derived\":" << rs.derived << ",\"propagated\":" << rs.propagated
+        << ",\"ms\":" << fixed << setprecision(3) << rs.seconds * 1000 << ",\"facts_per_sec\":" << setprecision(0)
+        << (rs.seconds > 0 ? rs.propagated / rs.seconds : 0) << ",\"fact_store_bytes\":" << kb.factStoreBytes()
+        << ",\"rule_store_bytes\":" << kb.ruleStoreBytes() << ",\"rules_written\":" << written
+        << ",\"first_order_rules\":" << kb.firstOrder.size() << ",\"rule_instances\":" << instances
+        << ",\"profiling\":" << (kb.profiling ? "true" : "false")
+        << ",\"rules\":[";
+    vector<RuleReport> rows = hottestRules(kb);
+    for (size_t i = 0; i < rows.size(); i++)
+        out << (i ? "," : "") << "{\"rule\":" << jsonString(rows[i].text) << ",\"attempts\":" << rows[i].attempts
+            << ",\"firings\":" << rows[i].firings << ",\"derived\":" << rows[i].derived << ",\"ms\":"
+            << setprecision(3) << rows[i].seconds * 1000 << "}";
+    out << "]}\n";
+}
+
+// ---------- Self-check ----------
+// Backward answers on rule sets full of cycles must equal the forward
+// closure and come within a fixed time; re-evaluating unfinished calls
+// separately makes them exponential
+int verifyCyclicTables() {
+    const double LIMIT_MS = 1000; // per case
+    struct Case {
+        string name;
+        vector<string> facts, rules, queries;
+    };
+    vector<Case> cases;
+    mt19937 rng(7);
+    for (int n : {40, 500})
+        for (bool seeded : {false, true}) {
+            Case c{"x_j -> x_i, 3 rules per symbol, " + to_string(n) + " symbols" + (seeded ? ", one fact" : ""), {}, {}, {}};
+            for (int i = 0; i < n; i++)
+                for (int k = 0; k < 3; k++) c.rules.push_back("x" + to_string(rng() % n) + " -> x" + to_string(i));
+            if (seeded) c.facts.push_back("x" + to_string(rng() % n));
+            for (int i = 0; i < n; i += max(1, n / 40)) c.queries.push_back("x" + to_string(i));
+            cases.push_back(c);
+        }
+    for (int n : {50, 150}) {
+        Case c{"path over a " + to_string(n) + "-node ring with chords", {}, {}, {}};
+        c.rules = {"edge(?x, ?y) -> path(?x, ?y)", "edge(?x, ?y) & path(?y, ?z) -> path(?x, ?z)"};
+        for (int i = 0; i < n; i++) {
+            c.facts.push_back("edge(n" + to_string(i) + ", n" + to_string((i + 1) % n) + ")");
+            c.facts.push_back("edge(n" + to_string(i) + ", n" + to_string(rng() % n) + ")");
+        }
+        c.queries = {"path(n0, n" + to_string(n - 1) + ")", "path(n1, ?y)", "path(?x, n2)", "path(?x, ?y)"};
+        cases.push_back(c);
+    }
+
+    int failures = 0;
+    for (auto &c : cases) {
+        KnowledgeBase backward, forward;
+        for (KnowledgeBase *kb : {&backward, &forward}) {
+            kb->quiet = true;
+            string error;
+            for (auto &r : c.rules) kb->addRuleText(r, error);
+            for (auto &f : c.facts) {
+                ParsedAtom a;
+                parseAtom(f, a);
+                kb->assertFact(kb->intern(canonical(a)));
+            }
+        }
+        forward.run();
+        BackwardChainer prover(backward);
+        int wrong = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (auto &text : c.queries) {
+            ParsedAtom q;
+            parseAtom(text, q);
+            vector<string> got, expect;
+            for (int a : prover.ask(q)) got.push_back(backward.names[a]);
+            for (int f : forward.factList) {
+                ParsedAtom a;
+                if (!forward.isFact[f] || !parseAtom(forward.names[f], a) || a.name != q.name) continue;
+                bool fits = true;
+                for (size_t i = 0; i < q.args.size(); i++)
+                    if (!isVariable(q.args[i]) && q.args[i] != a.args[i]) fits = false;
+                if (fits) expect.push_back(forward.names[f]);
+            }
+            sort(got.begin(), got.end());
+            sort(expect.begin(), expect.end());
+            if (got != expect) wrong++;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        bool ok = wrong == 0 && ms <= LIMIT_MS;
+        failures += !ok;
+        cout << (ok ? "ok    " : "FAIL  ") << c.name << ": " << c.queries.size() << " queries, " << wrong
+             << " wrong, " << fixed << setprecision(1) << ms << " ms (limit " << setprecision(0) << LIMIT_MS << ")\n";
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
+    if (argc >= 2 && string(argv[1]) == "verify") return verifyCyclicTables();
 
-    unordered_set<string> facts; // known true
-    vector<Rule> rules;
+    KnowledgeBase kb;
+    BackwardChainer prover(kb);
 
-    auto trim = [](string s){
-        auto issp = [](char c){ return isspace((unsigned char)c); };
-        while(!s.empty() && issp(s.front())) s.erase(s.begin());
-        while(!s.empty() && issp(s.back())) s.pop_back();
-        return s;
+    // Symbol id of a ground atom as typed (any spacing), -1 if unknown
+    auto symbolOf = [&](const string &text) {
+        ParsedAtom a;
+        if (parseAtom(text, a) && !hasVariables(a)) return kb.lookup(canonical(a));
+        return kb.lookup(trim(text));
     };
 
     cout << "Forward Chaining. Type 'help' for commands.\n";
@@ -48,66 +1903,125 @@ int main() {
         if (line=="exit") break;
         if (line=="help") {
             cout << "Commands:\n"
-                 << "  fact <symbol>\n"
-                 << "  rule <A [& B [& ...]] -> C>\n"
+                 << "  fact <atom>        # symbol or pred(a, b, ...)\n"
+                 << "  rule <A [& B [& ...]] -> C>   # atoms may use ?variables\n"
                  << "  run        # infer to fixpoint\n"
-                 << "  ask <symbol>\n"
+                 << "  ask <atom>         # proved backwards; ?variables list all answers\n"
+                 << "  prove <atom>       # show a proof tree\n"
+                 << "  retract <symbol>   # remove a fact and what depended on it\n"
+                 << "  incremental on|off # propagate each change immediately\n"
+                 << "  load-kb <file>     # bulk load fact/rule lines\n"
+                 << "  save <file>        # binary snapshot of everything\n"
+                 << "  load <file>        # replace the knowledge base with a snapshot\n"
+                 << "  quiet on|off       # stop printing every derived fact\n"
+                 << "  profile on|off     # time each rule (slower inference)\n"
+                 << "  stats              # inference counters and hottest rules\n"
+                 << "  stats json [file]  # the same as JSON\n"
+                 << "  stats reset\n"
                  << "  show\n"
                  << "  exit\n";
             continue;
         }
         if (line.rfind("fact ",0)==0) {
-            string f = trim(line.substr(5));
-            if (!f.empty()) { facts.insert(f); cout << "ok\n"; }
-            continue;
+            ParsedAtom f;
+            if (!parseAtom(line.substr(5), f)) { cout << "bad fact\n"; continue; }
+            if (hasVariables(f)) { cout << "facts must be ground\n"; continue; }
+            kb.assertFact(kb.intern(canonical(f)));
+            cout << "ok\n"; continue;
+        }
+        if (line.rfind("retract ",0)==0) {
+            int f = symbolOf(line.substr(8));
+            vector<int> removed;
+            if (f < 0 || !kb.retract(f, removed)) { cout << "not an asserted fact\n"; continue; }
+            for (int r : removed) cout << "Retracted: " << kb.names[r] << "\n";
+            if (kb.isFact[f]) cout << kb.names[f] << " still holds (derived)\n";
+            cout << "ok\n"; continue;
+        }
+        if (line=="incremental on" || line=="incremental off") {
+            kb.incremental = line=="incremental on";
+            if (kb.incremental) kb.run();
+            cout << "ok\n"; continue;
         }
         if (line.rfind("rule ",0)==0) {
-            string body = trim(line.substr(5));
-            auto pos = body.find("->");
-            if (pos==string::npos){ cout<<"bad rule\n"; continue; }
-            string lhs = trim(body.substr(0,pos));
-            string rhs = trim(body.substr(pos+2));
-            vector<string> ants;
-            {
-                string token; stringstream ss(lhs);
-                while (getline(ss, token, '&')) ants.push_back(trim(token));
-            }
-            rules.push_back({ants, rhs});
+            string error;
+            if (!kb.addRuleText(line.substr(5), error)) {
+                cout << "bad rule" << (error.empty() ? "" : ": " + error) << "\n";
+                continue;
+            }
+            cout << "ok\n"; continue;
+        }
+        if (line.rfind("load-kb ",0)==0) {
+            string path = trim(line.substr(8));
+            KnowledgeBase::LoadStats st;
+            auto t0 = chrono::steady_clock::now();
+            if (!kb.loadText(path, st)) { cout << "cannot read " << path << "\n"; continue; }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+            cout << "Loaded " << st.facts << " facts and " << st.rules << " rules from " << st.lines
+                 << " lines in " << fixed << setprecision(1) << ms << " ms (" << st.bad << " bad lines)\n";
+            continue;
+        }
+        if (line.rfind("save ",0)==0) {
+            string path = trim(line.substr(5));
+            cout << (kb.saveSnapshot(path) ? "ok\n" : "cannot write " + path + "\n");
+            continue;
+        }
+        if (line.rfind("load ",0)==0) {
+            string path = trim(line.substr(5));
+            auto t0 = chrono::steady_clock::now();
+            if (!kb.loadSnapshot(path)) { cout << "cannot load snapshot " << path << "\n"; continue; }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+            cout << "Loaded snapshot: " << kb.names.size() << " symbols, " << kb.numFacts << " facts, "
+                 << kb.rules.size() << " rules in " << fixed << setprecision(1) << ms << " ms\n";
+            continue;
+        }
+        if (line=="quiet on" || line=="quiet off") {
+            kb.quiet = line=="quiet on";
+            cout << "ok\n"; continue;
+        }
+        if (line=="profile on" || line=="profile off") {
+            kb.setProfiling(line=="profile on");
+            cout << "ok\n"; continue;
+        }
+        if (line=="stats") { printStats(kb, cout); continue; }
+        if (line=="stats reset") { kb.resetStats(); cout << "ok\n"; continue; }
+        if (line=="stats json" || line.rfind("stats json ",0)==0) {
+            string path = trim(line.substr(10));
+            if (path.empty()) { printStatsJson(kb, cout); continue; }
+            ofstream file(path);
+            if (!file) { cout << "cannot write " << path << "\n"; continue; }
+            printStatsJson(kb, file);
             cout << "ok\n"; continue;
         }
         if (line=="run") {
-            bool changed=true; size_t iterations=0;
-            while (changed) {
-                changed=false; iterations++;
-                for (auto &r: rules) {
-                    bool all=true;
-                    for (auto &a: r.antecedents) if (!facts.count(a)) { all=false; break; }
-                    if (all && !facts.count(r.consequent)) {
-                        facts.insert(r.consequent);
-                        changed=true;
-                        cout << "Derived: " << r.consequent << "\n";
-                    }
-                }
-                if (iterations>10000) { cout<<"stopping (loop guard)\n"; break; }
-            }
-            cout << "Done. Total facts: " << facts.size() << "\n";
+            kb.run();
+            cout << "Done. Total facts: " << kb.numFacts << "\n";
             continue;
         }
         if (line.rfind("ask ",0)==0) {
-            string q = trim(line.substr(4));
-            cout << (facts.count(q) ? "YES\n" : "NO\n");
+            ParsedAtom q;
+            if (!parseAtom(line.substr(4), q)) { cout << "NO\n"; continue; }
+            vector<int> found = prover.ask(q);
+            if (!hasVariables(q)) { cout << (found.empty() ? "NO\n" : "YES\n"); continue; }
+            if (found.empty()) cout << "NO\n";
+            for (int a : found) cout << "  " << kb.names[a] << "\n";
+            continue;
+        }
+        if (line.rfind("prove ",0)==0) {
+            ParsedAtom q;
+            if (!parseAtom(line.substr(6), q) || hasVariables(q)) { cout << "prove needs a ground atom\n"; continue; }
+            vector<int> found = prover.ask(q, true);
+            if (found.empty()) { cout << "NO\n"; continue; }
+            unordered_set<int> shown;
+            prover.printProof(found[0], 0, shown, cout);
             continue;
         }
         if (line=="show") {
-            cout << "Facts:\n"; for (auto &f: facts) cout << "  " << f << "\n";
+            cout << "Facts:\n";
+            for (int f: kb.factList) if (kb.isFact[f]) cout << "  " << kb.names[f] << "\n";
             cout << "Rules:\n";
-            for (auto &r: rules) {
-                for (size_t i=0;i<r.antecedents.size();++i) {
-                    if (i) cout << " & ";
-                    cout << r.antecedents[i];
-                }
-                cout << " -> " << r.consequent << "\n";
-            }
+            for (size_t r=0;r<kb.rules.size();++r)
+                if (kb.rules[r].origin < 0) cout << kb.ruleText(r) << "\n"; // skip first-order instances
+            for (auto &r: kb.firstOrder) cout << r.text << "\n";
             continue;
         }
         cout << "unknown command\n";